@@ -0,0 +1,156 @@
+// Compile-throughput benchmark: times each stage of clplc on generated programs of growing size.
+//
+// usage: clpl_bench [--quick] [--case=<NAME>] [--seed=<N>] [--reps=<N>] [-O<0-3>]
+
+#include "generator.hpp"
+
+#include "compiler.hpp"
+#include "parser.hpp"
+#include "scanner.hpp"
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+using namespace llvm;
+using clpl::bench::GeneratorOptions;
+
+namespace {
+    struct Case {
+        const char *name;
+        // Label of the parameter that grows along the curve.
+        const char *param;
+        std::function<void(GeneratorOptions&, unsigned)> apply;
+        std::vector<unsigned> sizes, quickSizes;
+    };
+
+    struct Sample {
+        size_t bytes = 0, tokens = 0, functions = 0;
+        double scan = 0, parse = 0, compile = 0, output = 0;
+
+        double total() const { return scan + parse + compile + output; }
+    };
+
+    double seconds(const std::function<void()> &f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Each stage is timed separately; the fastest of reps runs is kept.
+    Sample measure(const std::string &src, const GeneratorOptions &shape, const clpl::CompileOptions &options, unsigned reps) {
+        Sample best;
+        for (unsigned r = 0; r < reps; r++) {
+            Sample s;
+            s.bytes = src.size();
+            s.functions = shape.functions;
+
+            std::vector<clpl::Token> tokens;
+            s.scan = seconds([&] { tokens = clpl::Scanner(src).tokenize(); });
+            s.tokens = tokens.size();
+
+            clpl::Parser parser(src);
+            clpl::SList sts;
+            s.parse = seconds([&] { sts = parser.parse(); });
+
+            clpl::Compiler compiler("bench", sts, options);
+            s.compile = seconds([&] { compiler.compile(); });
+
+            SmallVector<char, 0> object;
+            raw_svector_ostream os(object);
+            s.output = seconds([&] { compiler.output(os); });
+
+            if (r == 0 || s.total() < best.total()) best = s;
+        }
+        return best;
+    }
+
+    std::vector<Case> cases() {
+        return {
+            {"functions", "functions", [](GeneratorOptions &o, unsigned n) { o.functions = n; },
+                {500, 1000, 2000, 4000, 8000}, {250, 500, 1000}},
+            {"long-expressions", "operands", [](GeneratorOptions &o, unsigned n) { o.functions = 10; o.statements = 4; o.depth = 0; o.exprLength = n; },
+                {250, 500, 1000, 2000, 4000}, {100, 200, 400}},
+            {"deep-nesting", "depth", [](GeneratorOptions &o, unsigned n) { o.functions = 10; o.statements = 1; o.depth = n; },
+                {100, 200, 400, 800}, {50, 100, 200}},
+            {"many-identifiers", "locals", [](GeneratorOptions &o, unsigned n) { o.functions = 20; o.identifiers = n; },
+                {100, 200, 400, 800, 1600}, {50, 100, 200}},
+            {"literal-heavy", "functions", [](GeneratorOptions &o, unsigned n) { o.functions = n; o.literalDensity = 1.0; },
+                {1000, 2000, 4000}, {250, 500}},
+            {"tiny-functions", "functions", [](GeneratorOptions &o, unsigned n) { o.functions = n; o.statements = 1; o.depth = 0; o.identifiers = 1; o.exprLength = 2; },
+                {25000, 50000, 100000}, {5000, 10000}},
+        };
+    }
+
+    void printHeader(raw_ostream &os) {
+        os << "case                     size        KiB     tokens    funcs   scan ms  parse ms  irgen ms   emit ms"
+              "       MB/s     Ktok/s    funcs/s\n";
+    }
+
+    void printSample(raw_ostream &os, const Case &c, unsigned size, const Sample &s) {
+        os << format("%-18s %10u %10zu %10zu %8zu %9.2f %9.2f %9.2f %9.2f %10.2f %10.1f %10.0f\n", c.name, size,
+                     s.bytes / 1024, s.tokens, s.functions, s.scan * 1e3, s.parse * 1e3, s.compile * 1e3, s.output * 1e3,
+                     s.bytes / s.total() / 1e6, s.tokens / s.total() / 1e3, s.functions / s.total());
+    }
+}
+
+int main(int argc, char **argv) {
+    bool quick = false;
+    std::string only;
+    uint64_t seed = 1;
+    unsigned reps = 3;
+    clpl::CompileOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--quick") quick = true;
+        else if (arg.starts_with("--case=")) only = arg.substr(strlen("--case="));
+        else if (arg.starts_with("--seed=")) seed = std::stoull(arg.substr(strlen("--seed=")));
+        else if (arg.starts_with("--reps=")) reps = std::max(1, std::stoi(arg.substr(strlen("--reps="))));
+        else if (arg.size() == 3 && arg.starts_with("-O") && arg[2] >= '0' && arg[2] <= '3') options.optLevel = arg[2] - '0';
+        else {
+            errs() << "usage: clpl_bench [--quick] [--case=<NAME>] [--seed=<N>] [--reps=<N>] [-O<0-3>]\n";
+            return 1;
+        }
+    }
+
+    auto &os = outs();
+    printHeader(os);
+    for (auto &c : cases()) {
+        if (!only.empty() && only != c.name) continue;
+
+        auto &sizes = quick ? c.quickSizes : c.sizes;
+        std::vector<Sample> samples;
+        for (auto size : sizes) {
+            GeneratorOptions shape;
+            shape.seed = seed;
+            c.apply(shape, size);
+
+            auto src = clpl::bench::generateProgram(shape);
+            try {
+                samples.push_back(measure(src, shape, options, reps));
+            }
+            catch (clpl::ParseError &e) {
+                errs() << e.msg << "\n";
+                return 1;
+            }
+            catch (clpl::CompileError &e) {
+                errs() << "error: " << e.msg << "\n";
+                return 1;
+            }
+            printSample(os, c, size, samples.back());
+            os.flush();
+        }
+
+        // Time per token at the largest size relative to the smallest; ~1x means linear scaling.
+        auto cost = [&](size_t i) { return samples[i].total() / samples[i].tokens; };
+        os << format("%-18s scaling %.2fx per token (%s %u -> %u)\n\n", c.name, cost(samples.size() - 1) / cost(0),
+                     c.param, sizes.front(), sizes.back());
+    }
+    return 0;
+}
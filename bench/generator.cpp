@@ -0,0 +1,120 @@
+#include "generator.hpp"
+
+#include <random>
+#include <vector>
+
+namespace {
+    std::string numbered(char prefix, unsigned n) {
+        std::string out(1, prefix);
+        out += std::to_string(n);
+        return out;
+    }
+
+    // Everything is i32, so any operand fits anywhere; calls only go to earlier functions.
+    class Generator {
+        private:
+            const clpl::bench::GeneratorOptions &options;
+            std::mt19937_64 rng;
+            std::string out;
+            std::vector<std::string> visible;
+            unsigned function = 0;
+            unsigned temporaries = 0;
+
+            unsigned pick(unsigned n) {
+                return std::uniform_int_distribution<unsigned>(0, n - 1)(rng);
+            }
+
+            bool chance(double p) {
+                return std::bernoulli_distribution(p)(rng);
+            }
+
+            void indent(unsigned level) {
+                out.append(level * 4, ' ');
+            }
+
+            void operand() {
+                if (visible.empty() || chance(options.literalDensity)) {
+                    out += std::to_string(pick(1000));
+                }
+                else if (function > 0 && chance(0.05)) {
+                    out += numbered('f', pick(function));
+                    out += "(" + visible[pick(visible.size())] + ", " + std::to_string(pick(100)) + ")";
+                }
+                else {
+                    out += visible[pick(visible.size())];
+                }
+            }
+
+            void expression() {
+                static const char *ops[] = {" + ", " - ", " * "};
+                operand();
+                for (unsigned i = 1; i < options.exprLength; i++) {
+                    out += ops[pick(3)];
+                    operand();
+                }
+            }
+
+            void block(unsigned level, unsigned depth) {
+                auto scope = visible.size();
+                // The last statement always nests, so every shape reaches the requested depth.
+                for (unsigned i = 0; i < options.statements; i++) {
+                    statement(level, depth, i + 1 == options.statements && depth > 0);
+                }
+                visible.resize(scope);
+            }
+
+            void statement(unsigned level, unsigned depth, bool nest) {
+                unsigned kind = nest ? 3 + pick(2) : pick(depth > 0 ? 5 : 3);
+                indent(level);
+                if (kind == 0) {
+                    auto name = numbered('t', temporaries++);
+                    out += "var " + name + ": i32 = ";
+                    expression();
+                    out += ";\n";
+                    visible.push_back(name);
+                }
+                else if (kind <= 2) {
+                    out += visible[pick(visible.size())] + " = ";
+                    expression();
+                    out += ";\n";
+                }
+                else {
+                    out += kind == 3 ? "if (" : "while (";
+                    expression();
+                    out += " < ";
+                    expression();
+                    out += ") {\n";
+                    block(level + 1, depth - 1);
+                    indent(level);
+                    out += "}\n";
+                }
+            }
+
+        public:
+            explicit Generator(const clpl::bench::GeneratorOptions &options) : options(options), rng(options.seed) { }
+
+            std::string run() {
+                for (function = 0; function < options.functions; function++) {
+                    temporaries = 0;
+                    visible = {"a", "b"};
+                    out += "func " + numbered('f', function) + "(a: i32, b: i32) -> i32 {\n";
+                    for (unsigned i = 0; i < std::max(options.identifiers, 1u); i++) {
+                        auto name = numbered('v', i);
+                        out += "    var " + name + ": i32 = ";
+                        expression();
+                        out += ";\n";
+                        visible.push_back(name);
+                    }
+                    block(1, options.depth);
+                    out += "    return ";
+                    expression();
+                    out += ";\n}\n";
+                }
+                return std::move(out);
+            }
+    };
+}
+
+std::string clpl::bench::generateProgram(const GeneratorOptions &options) {
+    return Generator(options).run();
+}
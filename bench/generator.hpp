@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace clpl::bench {
+    // Shape of a synthetic CLPL program. The same options and seed always produce the same text.
+    struct GeneratorOptions {
+        uint64_t seed = 1;
+        unsigned functions = 100;
+        // Statements in each function body, and in each nested block.
+        unsigned statements = 8;
+        // How deep if/while blocks nest inside a function body.
+        unsigned depth = 2;
+        // Operands per expression.
+        unsigned exprLength = 4;
+        // Probability (0-1) that an operand is a literal rather than an identifier or call.
+        double literalDensity = 0.3;
+        // Local variables declared at the top of each function.
+        unsigned identifiers = 4;
+    };
+
+    std::string generateProgram(const GeneratorOptions &options);
+}
@@ -0,0 +1,187 @@
+// Generated-code benchmark: runs every kernel built from CLPL (by clplc) and from C at -O0..-O3 and
+// prints a table of the fastest run of each. With --baseline it exits with 1 when a kernel's CLPL/C
+// time ratio at -O2 exceeds the recorded one by more than --threshold.
+//
+// usage: clpl_kernel_bench --dir=<DIR> [--kernel=<NAME>] [--reps=<N>] [--baseline=<FILE> [--threshold=<X>]]
+//                          [--write-baseline=<FILE>]
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+    struct Kernel {
+        const char *name;
+        // Input size passed to kernel(n); picked so that -O2 runs take a few hundred milliseconds.
+        const char *n;
+    };
+
+    const Kernel kernels[] = {
+        {"fib", "32"},
+        {"hash", "50000000"},
+        {"nbody", "2000000"},
+        {"sieve", "10000000"},
+        {"matmul", "200"},
+        {"strscan", "20000000"},
+        {"mix", "30000"},
+        {"mix_norestrict", "30000"},
+        {"rotate", "5000000"},
+    };
+
+    struct Run {
+        double ms;
+        long long checksum;
+    };
+
+    std::optional<Run> run(const std::string &program, const char *n, unsigned reps, std::string &error) {
+        SmallString<128> outPath;
+        if (sys::fs::createTemporaryFile("clpl-kernel", "txt", outPath)) {
+            error = "unable to create a temporary file";
+            return std::nullopt;
+        }
+
+        auto repsArg = std::to_string(reps);
+        StringRef args[] = {program, n, repsArg};
+        Optional<StringRef> redirects[] = {None, StringRef(outPath), None};
+        int status = sys::ExecuteAndWait(program, args, None, redirects, 0, 0, &error);
+
+        auto buffer = MemoryBuffer::getFile(outPath);
+        sys::fs::remove(outPath);
+        if (status != 0) {
+            if (error.empty()) error = "exited with status " + std::to_string(status);
+            return std::nullopt;
+        }
+
+        long long ns = 0, checksum = 0;
+        if (!buffer || sscanf((*buffer)->getBufferStart(), "%lld %lld", &ns, &checksum) != 2) {
+            error = "unexpected output";
+            return std::nullopt;
+        }
+        return Run{ns / 1e6, checksum};
+    }
+
+    // Lines of "<kernel> <CLPL/C ratio at -O2>"; '#' starts a comment line.
+    std::map<std::string, double> readBaseline(const std::string &path) {
+        std::map<std::string, double> out;
+        std::ifstream in(path);
+        std::string line, name;
+        double ratio;
+        while (std::getline(in, line)) {
+            if (line.starts_with("#")) continue;
+            std::istringstream fields(line);
+            if (fields >> name >> ratio) out[name] = ratio;
+        }
+        return out;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string dir, only, baselinePath, writeBaselinePath;
+    unsigned reps = 3;
+    double threshold = 1.25;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.starts_with("--dir=")) dir = arg.substr(strlen("--dir="));
+        else if (arg.starts_with("--kernel=")) only = arg.substr(strlen("--kernel="));
+        else if (arg.starts_with("--reps=")) reps = std::max(1, std::stoi(arg.substr(strlen("--reps="))));
+        else if (arg.starts_with("--baseline=")) baselinePath = arg.substr(strlen("--baseline="));
+        else if (arg.starts_with("--threshold=")) threshold = std::stod(arg.substr(strlen("--threshold=")));
+        else if (arg.starts_with("--write-baseline=")) writeBaselinePath = arg.substr(strlen("--write-baseline="));
+        else {
+            dir.clear();
+            break;
+        }
+    }
+    if (dir.empty()) {
+        errs() << "usage: clpl_kernel_bench --dir=<DIR> [--kernel=<NAME>] [--reps=<N>] [--baseline=<FILE> [--threshold=<X>]]\n"
+               << "                         [--write-baseline=<FILE>]\n";
+        return 1;
+    }
+
+    auto baseline = baselinePath.empty() ? std::map<std::string, double>() : readBaseline(baselinePath);
+    std::map<std::string, double> ratios;
+    bool failed = false;
+
+    auto &os = outs();
+    os << "times in ms      ---------------- C ----------------  --------------- CLPL --------------  CLPL/C\n"
+          "kernel                O0       O1       O2       O3       O0       O1       O2       O3      O2\n";
+    for (auto &k : kernels) {
+        if (!only.empty() && only != k.name) continue;
+
+        os << format("%-12s", k.name);
+        os.flush();
+
+        std::map<std::string, Run> runs;
+        std::optional<long long> checksum;
+        bool mismatch = false;
+        for (const char *lang : {"c", "clpl"}) {
+            for (int level = 0; level <= 3; level++) {
+                auto variant = std::string(lang) + "-O" + std::to_string(level);
+                SmallString<128> program(dir);
+                sys::path::append(program, std::string(k.name) + "-" + variant);
+
+                std::string error;
+                auto r = run(std::string(program), k.n, reps, error);
+                if (!r) {
+                    os << "\n";
+                    errs() << "error: " << program << ": " << error << "\n";
+                    return 1;
+                }
+                if (checksum && *checksum != r->checksum) mismatch = true;
+                checksum = r->checksum;
+                runs[variant] = *r;
+                os << format(" %8.1f", r->ms);
+                os.flush();
+            }
+        }
+
+        double ratio = runs["clpl-O2"].ms / runs["c-O2"].ms;
+        ratios[k.name] = ratio;
+        os << format(" %7.2fx", ratio);
+        if (mismatch) {
+            os << "  checksum mismatch";
+            failed = true;
+        }
+        if (baseline.contains(k.name) && ratio > baseline[k.name] * threshold) {
+            os << format("  regressed (baseline %.2fx)", baseline[k.name]);
+            failed = true;
+        }
+        os << "\n";
+    }
+
+    if (!writeBaselinePath.empty()) {
+        // Keep the comments of the file being replaced, and the kernels that were not run.
+        std::vector<std::string> comments;
+        {
+            std::ifstream in(writeBaselinePath);
+            std::string line;
+            while (std::getline(in, line)) {
+                if (line.starts_with("#")) comments.push_back(line);
+            }
+        }
+        auto merged = readBaseline(writeBaselinePath);
+        for (auto &[name, ratio] : ratios) merged[name] = ratio;
+
+        std::ofstream out(writeBaselinePath);
+        for (auto &line : comments) out << line << "\n";
+        for (auto &[name, ratio] : merged) out << name << " " << ratio << "\n";
+    }
+    return failed ? 1 : 0;
+}
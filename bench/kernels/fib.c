@@ -0,0 +1,10 @@
+#include "harness.h"
+
+static int fib(int n) {
+    if (n < 2) return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+int kernel(int n) {
+    return fib(n);
+}
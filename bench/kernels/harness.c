@@ -0,0 +1,58 @@
+#include "harness.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+int *alloc_i32(int n) { return calloc(n, sizeof(int)); }
+double *alloc_f64(int n) { return calloc(n, sizeof(double)); }
+void free_i32(int *p) { free(p); }
+void free_f64(double *p) { free(p); }
+void free_u8(unsigned char *p) { free(p); }
+
+void **alloc_slots(int n) { return calloc(n, sizeof(void *)); }
+int **slot_rows(void **slots) { return (int **) slots; }
+void free_slots(void **slots) { free(slots); }
+
+unsigned char *make_text(int n) {
+    unsigned char *text = malloc(n);
+    unsigned state = 12345;
+    for (int i = 0; i < n; i++) {
+        state = state * 1103515245u + 12345u;
+        unsigned r = (state >> 16) % 32;
+        text[i] = r < 26 ? 'a' + r : r < 31 ? ' ' : '\n';
+    }
+    return text;
+}
+
+int f64_checksum(double x) {
+    return (int) fmod(x * 1000.0, 1e9);
+}
+
+static long long now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// usage: <kernel> <n> [reps]; prints the fastest run in nanoseconds and the kernel's checksum.
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <n> [reps]\n", argv[0]);
+        return 1;
+    }
+    int n = atoi(argv[1]);
+    int reps = argc > 2 ? atoi(argv[2]) : 1;
+
+    long long best = -1;
+    int result = 0;
+    for (int r = 0; r < reps; r++) {
+        long long start = now();
+        result = kernel(n);
+        long long elapsed = now() - start;
+        if (best < 0 || elapsed < best) best = elapsed;
+    }
+    printf("%lld %d\n", best, result);
+    return 0;
+}
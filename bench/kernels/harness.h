@@ -0,0 +1,21 @@
+#pragma once
+
+// Runtime shared by the CLPL and C versions of every kernel.
+
+int kernel(int n);
+
+int *alloc_i32(int n);
+double *alloc_f64(int n);
+void free_i32(int *p);
+void free_f64(double *p);
+void free_u8(unsigned char *p);
+
+// A table of n pointer slots, and the same table typed as rows of ints.
+void **alloc_slots(int n);
+int **slot_rows(void **slots);
+void free_slots(void **slots);
+
+// n bytes of lowercase words separated by spaces and newlines, the same on every run.
+unsigned char *make_text(int n);
+
+int f64_checksum(double x);
@@ -0,0 +1,9 @@
+#include "harness.h"
+
+int kernel(int n) {
+    unsigned h = 5381;
+    for (int i = 0; i < n; i++) {
+        h = h * 33 + (unsigned) (i % 251);
+    }
+    return (int) h;
+}
@@ -0,0 +1,32 @@
+#include "harness.h"
+
+int kernel(int n) {
+    double *a = alloc_f64(n * n);
+    double *b = alloc_f64(n * n);
+    double *c = alloc_f64(n * n);
+
+    double x = 0.0, y = 1.0;
+    for (int k = 0; k < n * n; k++) {
+        a[k] = x;
+        b[k] = y;
+        x = x + 0.5;
+        if (x > 3.0) x = 0.0;
+        y = y + 0.25;
+        if (y > 2.0) y = 1.0;
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < n; k++) sum = sum + a[i * n + k] * b[k * n + j];
+            c[i * n + j] = sum;
+        }
+    }
+
+    double total = 0.0;
+    for (int k = 0; k < n * n; k++) total = total + c[k];
+    free_f64(a);
+    free_f64(b);
+    free_f64(c);
+    return f64_checksum(total);
+}
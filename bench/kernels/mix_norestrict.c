@@ -0,0 +1,46 @@
+#include "harness.h"
+
+// mix without restrict: the pointers may alias, so the loop stays scalar. Compare with mix.
+static void mix(double *sum, double *diff, double *cross, const double *a, const double *b, const double *c,
+                const double *d, int n) {
+    for (int i = 0; i < n; i++) {
+        sum[i] = a[i] + b[i];
+        diff[i] = c[i] - d[i];
+        cross[i] = a[i] * d[i] - b[i] * c[i];
+    }
+}
+
+int kernel(int n) {
+    int size = 4096;
+    double *a = alloc_f64(size);
+    double *b = alloc_f64(size);
+    double *c = alloc_f64(size);
+    double *d = alloc_f64(size);
+    double *sum = alloc_f64(size);
+    double *diff = alloc_f64(size);
+    double *cross = alloc_f64(size);
+
+    double x = 0.0;
+    for (int i = 0; i < size; i++) {
+        a[i] = 0.5 * x;
+        b[i] = 1.0 + 0.25 * x;
+        c[i] = 2.0 - 0.125 * x;
+        d[i] = 0.75;
+        x = x + 1.0;
+    }
+
+    double total = 0.0;
+    for (int rep = 0; rep < n; rep++) {
+        mix(sum, diff, cross, a, b, c, d, size);
+        total = total + sum[rep % size] + diff[rep % size] + cross[rep % size];
+    }
+
+    free_f64(a);
+    free_f64(b);
+    free_f64(c);
+    free_f64(d);
+    free_f64(sum);
+    free_f64(diff);
+    free_f64(cross);
+    return f64_checksum(total);
+}
@@ -0,0 +1,56 @@
+#include "harness.h"
+
+#include <math.h>
+
+int kernel(int n) {
+    double x1 = 0.0;
+    double y1 = 0.0;
+    double vx1 = 0.0;
+    double vy1 = 0.0;
+    double m1 = 10.0;
+    double x2 = 1.0;
+    double y2 = 0.0;
+    double vx2 = 0.0;
+    double vy2 = 3.0;
+    double m2 = 1.0;
+    double x3 = -1.5;
+    double y3 = 0.0;
+    double vx3 = 0.0;
+    double vy3 = -2.5;
+    double m3 = 0.5;
+    double dt = 0.0001;
+    double dx, dy, d2, f;
+    for (int step = 0; step < n; step++) {
+        dx = x2 - x1;
+        dy = y2 - y1;
+        d2 = dx * dx + dy * dy + 0.01;
+        f = dt / (d2 * sqrt(d2));
+        vx1 = vx1 + dx * m2 * f;
+        vy1 = vy1 + dy * m2 * f;
+        vx2 = vx2 - dx * m1 * f;
+        vy2 = vy2 - dy * m1 * f;
+        dx = x3 - x1;
+        dy = y3 - y1;
+        d2 = dx * dx + dy * dy + 0.01;
+        f = dt / (d2 * sqrt(d2));
+        vx1 = vx1 + dx * m3 * f;
+        vy1 = vy1 + dy * m3 * f;
+        vx3 = vx3 - dx * m1 * f;
+        vy3 = vy3 - dy * m1 * f;
+        dx = x3 - x2;
+        dy = y3 - y2;
+        d2 = dx * dx + dy * dy + 0.01;
+        f = dt / (d2 * sqrt(d2));
+        vx2 = vx2 + dx * m3 * f;
+        vy2 = vy2 + dy * m3 * f;
+        vx3 = vx3 - dx * m2 * f;
+        vy3 = vy3 - dy * m2 * f;
+        x1 = x1 + dt * vx1;
+        y1 = y1 + dt * vy1;
+        x2 = x2 + dt * vx2;
+        y2 = y2 + dt * vy2;
+        x3 = x3 + dt * vx3;
+        y3 = y3 + dt * vy3;
+    }
+    return f64_checksum(x1 + y1 + x2 + y2 + x3 + y3);
+}
@@ -0,0 +1,25 @@
+#include "harness.h"
+
+int kernel(int n) {
+    int count = 64;
+    int width = 256;
+    void **slots = alloc_slots(count);
+    int **rows = slot_rows(slots);
+
+    for (int i = 0; i < count; i++) {
+        rows[i] = alloc_i32(width);
+        for (int j = 0; j < width; j++) rows[i][j] = i * width + j;
+    }
+
+    int total = 0;
+    for (int rep = 0; rep < n; rep++) {
+        void *first = slots[0];
+        for (int i = 0; i < count - 1; i++) slots[i] = slots[i + 1];
+        slots[count - 1] = first;
+        total = (total + rows[0][rep % width]) % 1000003;
+    }
+
+    for (int i = 0; i < count; i++) free_i32(rows[i]);
+    free_slots(slots);
+    return total;
+}
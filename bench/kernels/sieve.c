@@ -0,0 +1,16 @@
+#include "harness.h"
+
+int kernel(int n) {
+    int *composite = alloc_i32(n + 1);
+    int count = 0;
+    for (int i = 2; i <= n; i++) {
+        if (composite[i] == 0) {
+            count++;
+            if (i <= n / i) {
+                for (int j = i * i; j <= n; j += i) composite[j] = 1;
+            }
+        }
+    }
+    free_i32(composite);
+    return count;
+}
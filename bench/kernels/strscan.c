@@ -0,0 +1,19 @@
+#include "harness.h"
+
+int kernel(int n) {
+    unsigned char *text = make_text(n);
+    int words = 0, lines = 0, vowels = 0;
+    int inWord = 0;
+    for (int i = 0; i < n; i++) {
+        int c = text[i];
+        if (c == '\n') lines++;
+        if (c == ' ' || c == '\n') inWord = 0;
+        else if (!inWord) {
+            inWord = 1;
+            words++;
+        }
+        if (c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u') vowels++;
+    }
+    free_u8(text);
+    return words * 7 + lines * 3 + vowels;
+}
@@ -0,0 +1,158 @@
+#include "api.hpp"
+#include "boundedqueue.hpp"
+#include "timing.hpp"
+#include "memreport.hpp"
+
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <optional>
+#include <thread>
+
+using namespace llvm;
+
+// How many parsed top-level statements may wait for code generation.
+static const size_t pipelineDepth = 64;
+
+std::string clpl::Diagnostic::format() const {
+    std::string out = warning ? "\033[1;35mWarning: " : "\033[1;31mError: ";
+    if (line > 0) out += "(at line " + std::to_string(line) + ")";
+    out += "\033[0m\n\t\033[1m" + message + "\033[0m";
+    return out;
+}
+
+// Parses on a helper thread while this one generates code for each statement as it arrives.
+static std::unique_ptr<clpl::Compiler> compilePipelined(std::string_view source, const clpl::CompileOptions &options, StringRef moduleName, clpl::PhaseTimers *timers, clpl::MemoryReport *memory) {
+    auto compiler = std::make_unique<clpl::Compiler>(moduleName.str().c_str(), clpl::SList{}, options);
+    compiler->setPhaseTimers(timers);
+    compiler->setMemoryReport(memory);
+    clpl::BoundedQueue<clpl::StmtSP> queue(pipelineDepth);
+    std::exception_ptr parseError;
+
+    std::thread parserThread([&] {
+        try {
+            std::optional<clpl::Parser> parser;
+            {
+                clpl::PhaseScope scope(timers, clpl::Phase::Scanning, memory);
+                parser.emplace(std::string(source), memory);
+            }
+            while (true) {
+                clpl::StmtSP st;
+                {
+                    clpl::PhaseScope scope(timers, clpl::Phase::Parsing, memory);
+                    st = parser->parseNext();
+                }
+                if (st == nullptr || !queue.push(st)) break;
+            }
+            if (memory != nullptr) memory->recordParser(parser->stats());
+        }
+        catch (...) {
+            parseError = std::current_exception();
+        }
+        queue.close();
+    });
+
+    try {
+        clpl::StmtSP st;
+        while (queue.pop(st)) {
+            compiler->compileTopLevel(st);
+        }
+    }
+    catch (...) {
+        queue.close();
+        parserThread.join();
+        throw;
+    }
+    parserThread.join();
+
+    if (parseError) std::rethrow_exception(parseError);
+    return compiler;
+}
+
+clpl::CompileResult clpl::compileToObject(std::string_view source, const CompileOptions &options, StringRef moduleName) {
+    CompileResult result;
+
+    std::optional<PhaseTimers> timers;
+    if (options.timeReport) timers.emplace();
+    auto *timersPtr = timers ? &*timers : nullptr;
+
+    std::optional<MemoryReport> memory;
+    if (options.memReport) memory.emplace();
+    auto *memoryPtr = memory ? &*memory : nullptr;
+
+    if (options.timeTrace) timeTraceProfilerInitialize(options.timeTraceGranularity, "clplc");
+    auto traceCleanup = make_scope_exit([&] {
+        if (options.timeTrace) timeTraceProfilerCleanup();
+    });
+
+    bool backendFailed = false;
+    try {
+        std::unique_ptr<Compiler> compiler;
+        {
+            TimeTraceScope trace("Compile", moduleName);
+            if (options.pipeline) {
+                compiler = compilePipelined(source, options, moduleName, timersPtr, memoryPtr);
+            }
+            else {
+                std::optional<Parser> parser;
+                {
+                    PhaseScope scope(timersPtr, Phase::Scanning, memoryPtr);
+                    parser.emplace(std::string(source), memoryPtr);
+                }
+                SList sts;
+                {
+                    PhaseScope scope(timersPtr, Phase::Parsing, memoryPtr);
+                    sts = parser->parse();
+                }
+                if (memory) memory->recordParser(parser->stats());
+
+                compiler = std::make_unique<Compiler>(moduleName.str().c_str(), sts, options);
+                compiler->setPhaseTimers(timersPtr);
+                compiler->setMemoryReport(memoryPtr);
+                compiler->compile();
+            }
+
+            if (options.dumpIR) {
+                raw_string_ostream os(result.ir);
+                compiler->print(os);
+            }
+
+            raw_svector_ostream os(result.object);
+            compiler->output(os);
+            result.remarks = compiler->remarks();
+            for (auto &m : compiler->backendDiagnostics()) {
+                bool isError = m.severity == DS_Error;
+                result.diagnostics.push_back({0, m.text, !isError});
+                backendFailed |= isError;
+            }
+            // Flushes the pass timings still held by the compiler into the report.
+            compiler.reset();
+        }
+        result.success = !backendFailed;
+    }
+    catch (ParseError &e) {
+        result.diagnostics.push_back({e.line, e.detail});
+    }
+    catch (CompileError &e) {
+        result.diagnostics.push_back({0, e.msg});
+    }
+    catch (std::exception &e) {
+        result.diagnostics.push_back({0, std::string("Internal compiler error: ") + e.what()});
+    }
+
+    if (timers) {
+        raw_string_ostream os(result.timeReport);
+        timers->print(os);
+    }
+    if (memory) {
+        raw_string_ostream os(result.memReport);
+        memory->print(os);
+    }
+    if (options.timeTrace) {
+        SmallVector<char, 0> trace;
+        raw_svector_ostream os(trace);
+        timeTraceProfilerWrite(os);
+        result.timeTrace.assign(trace.begin(), trace.end());
+    }
+    return result;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+
+#include "compiler.hpp"
+
+namespace clpl {
+    struct Diagnostic {
+        // 0 when the error isn't tied to a source line.
+        int line;
+        std::string message;
+        // Warnings from LLVM are passed on even when the compile succeeds.
+        bool warning = false;
+
+        // The message as clplc prints it on a terminal.
+        std::string format() const;
+    };
+
+    struct CompileResult {
+        bool success = false;
+        // Object file, or bitcode with -flto.
+        llvm::SmallVector<char, 0> object;
+        std::vector<Diagnostic> diagnostics;
+        // Unoptimized module, only with CompileOptions::dumpIR.
+        std::string ir;
+        // Only with CompileOptions::timeReport and CompileOptions::timeTrace (Chrome trace JSON).
+        std::string timeReport;
+        std::string timeTrace;
+        // Only with CompileOptions::memReport.
+        std::string memReport;
+        // Optimization remarks picked by the CompileOptions::remarks* patterns, one per line.
+        std::string remarks;
+    };
+
+    // Compiles a CLPL translation unit entirely in memory. Errors are returned as diagnostics; it
+    // never prints, throws or exits, and is safe to call from several threads at once.
+    CompileResult compileToObject(std::string_view source, const CompileOptions &options, llvm::StringRef moduleName = "clpl");
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace clpl {
+    // Single-lock FIFO with a fixed capacity; push blocks while full, pop while empty.
+    template<typename T>
+    class BoundedQueue {
+        private:
+            std::mutex mutex;
+            std::condition_variable notFull, notEmpty;
+            std::deque<T> items;
+            size_t capacity;
+            bool closed = false;
+
+        public:
+            explicit BoundedQueue(size_t capacity) : capacity(capacity) { }
+
+            // Returns false if the queue was closed before the item could be added.
+            bool push(T item) {
+                std::unique_lock lock(mutex);
+                notFull.wait(lock, [&] { return closed || items.size() < capacity; });
+                if (closed) return false;
+                items.push_back(std::move(item));
+                notEmpty.notify_one();
+                return true;
+            }
+
+            // Returns false once the queue is closed and drained.
+            bool pop(T &item) {
+                std::unique_lock lock(mutex);
+                notEmpty.wait(lock, [&] { return closed || !items.empty(); });
+                if (items.empty()) return false;
+                item = std::move(items.front());
+                items.pop_front();
+                notFull.notify_one();
+                return true;
+            }
+
+            void close() {
+                std::lock_guard lock(mutex);
+                closed = true;
+                notFull.notify_all();
+                notEmpty.notify_all();
+            }
+    };
+}
@@ -0,0 +1,108 @@
+#include "cacheutil.hpp"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+using namespace llvm;
+using clpl::CacheKey;
+
+CacheKey::CacheKey(StringRef kind) {
+    add(kind);
+    add(LLVM_VERSION_STRING);
+
+    // Rebuilding clplc invalidates everything it cached, even without a version bump.
+    auto self = sys::fs::getMainExecutable(nullptr, (void *) &clpl::pruneCacheDir);
+    sys::fs::file_status status;
+    if (!sys::fs::status(self, status)) {
+        add(std::to_string(status.getSize()));
+        add(std::to_string(sys::toTimeT(status.getLastModificationTime())));
+    }
+
+    add(sys::getDefaultTargetTriple());
+}
+
+CacheKey &CacheKey::add(StringRef field) {
+    data += std::to_string(field.size());
+    data += ':';
+    data += field;
+    return *this;
+}
+
+std::string CacheKey::str() const {
+    return toHex(SHA256::hash(arrayRefFromStringRef(data)), true);
+}
+
+bool clpl::publishCacheEntry(const std::string &dir, const std::string &name, function_ref<std::error_code(int fd)> write) {
+    SmallString<256> model(dir);
+    sys::path::append(model, "tmp-%%%%%%%%.part");
+
+    int fd;
+    SmallString<256> tmp;
+    if (sys::fs::createUniqueFile(model, fd, tmp)) return false;
+
+    auto EC = write(fd);
+    sys::fs::closeFile(fd);
+
+    SmallString<256> entry(dir);
+    sys::path::append(entry, name);
+    if (EC || sys::fs::rename(tmp, entry)) {
+        sys::fs::remove(tmp);
+        return false;
+    }
+    return true;
+}
+
+bool clpl::touchCacheEntry(const std::string &path) {
+    int fd;
+    if (sys::fs::openFileForRead(path, fd)) return false;
+    sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+    sys::fs::closeFile(fd);
+    return true;
+}
+
+void clpl::pruneCacheDir(const std::string &dir, StringRef ext, uint64_t maxSize) {
+    struct Entry {
+        std::string path;
+        uint64_t size;
+        sys::TimePoint<> used;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+
+    // Temp files of writers that died before publishing; live ones are never this old.
+    auto staleBefore = std::chrono::system_clock::now() - std::chrono::hours(1);
+
+    std::error_code EC;
+    for (sys::fs::directory_iterator it(dir, EC), end; it != end && !EC; it.increment(EC)) {
+        auto name = sys::path::filename(it->path());
+        if (name.startswith("tmp-") && name.endswith(".part")) {
+            sys::fs::file_status status;
+            if (!sys::fs::status(it->path(), status) && status.getLastModificationTime() < staleBefore) sys::fs::remove(it->path());
+            continue;
+        }
+        if (sys::path::extension(it->path()) != ext) continue;
+
+        sys::fs::file_status status;
+        if (sys::fs::status(it->path(), status)) continue;
+        entries.push_back({it->path(), status.getSize(), status.getLastModificationTime()});
+        total += status.getSize();
+    }
+    if (total <= maxSize) return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.used < b.used; });
+    for (auto &e : entries) {
+        if (total <= maxSize) break;
+        if (!sys::fs::remove(e.path)) total -= e.size;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+#include <llvm/ADT/STLFunctionalExtras.h>
+#include <llvm/ADT/StringRef.h>
+
+namespace clpl {
+    // Hashes length-prefixed fields into a hex SHA-256 cache key. Every key starts with the
+    // cache kind, the LLVM version, an identity of the running clplc binary and the target triple.
+    class CacheKey {
+        private:
+            std::string data;
+
+        public:
+            explicit CacheKey(llvm::StringRef kind);
+            CacheKey &add(llvm::StringRef field);
+            std::string str() const;
+    };
+
+    // Writes dir/name through a unique temp file and an atomic rename. Returns false on failure.
+    bool publishCacheEntry(const std::string &dir, const std::string &name, llvm::function_ref<std::error_code(int fd)> write);
+
+    // Marks an entry as recently used. Returns false if it doesn't exist.
+    bool touchCacheEntry(const std::string &path);
+
+    // Deletes the least recently modified dir/*<ext> files until they add up to at most maxSize bytes,
+    // and temp files left behind by publishCacheEntry calls that never finished.
+    void pruneCacheDir(const std::string &dir, llvm::StringRef ext, uint64_t maxSize);
+}
@@ -1,23 +1,98 @@
 #include "compiler.hpp"
+#include "target.hpp"
+#include "timing.hpp"
+#include "memreport.hpp"
+#include "remarks.hpp"
 
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/raw_ostream.h"
 
-#include "llvm/ExecutionEngine/ExecutionEngine.h"
-#include "llvm/Support/TargetSelect.h"
-#include "llvm/ADT/Optional.h"
-#include "llvm/MC/TargetRegistry.h"
+#include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/LegacyPassManager.h"
-
-#include "llvm/Transforms/Scalar.h"
-#include "llvm/Analysis/BasicAliasAnalysis.h"
-#include "llvm/Transforms/Utils.h"
+#include "llvm/IR/LLVMRemarkStreamer.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/PassTimingInfo.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Analysis/ModuleSummaryAnalysis.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/ProfileData/InstrProfReader.h"
+#include "llvm/ProfileData/SampleProfReader.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/IPO/GlobalDCE.h"
+#include "llvm/Transforms/IPO/Inliner.h"
+#include "llvm/Transforms/Scalar/EarlyCSE.h"
+#include "llvm/Transforms/Scalar/SimplifyCFG.h"
+#include "llvm/Transforms/Scalar/SROA.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+#include <optional>
 
 using namespace llvm;
 using clpl::Compiler;
 
-Compiler::Compiler(const char *fname, const SList &statements) : statements(statements), mod(fname, context), builder(context) {
+struct clpl::PassContext {
+    LoopAnalysisManager lam;
+    FunctionAnalysisManager fam;
+    CGSCCAnalysisManager cgam;
+    ModuleAnalysisManager mam;
+    PassInstrumentationCallbacks pic;
+    std::optional<TimePassesHandler> timePasses;
+    PassBuilder pb;
+    FunctionPassManager fpm;
+
+    PassContext(TargetMachine *targetMachine, PhaseTimers *timers, Optional<PGOOptions> pgo = None) : pb(targetMachine, PipelineTuningOptions(), pgo, &pic) {
+        if (timers != nullptr) {
+            timePasses.emplace(true);
+            timePasses->setOutStream(timers->passStream());
+            timePasses->registerCallbacks(pic);
+        }
+        pb.registerModuleAnalyses(mam);
+        pb.registerCGSCCAnalyses(cgam);
+        pb.registerFunctionAnalyses(fam);
+        pb.registerLoopAnalyses(lam);
+        pb.crossRegisterProxies(lam, fam, cgam, mam);
+    }
+};
+
+static Optional<PGOOptions> toPGOOptions(const clpl::CompileOptions &options, LLVMContext &context) {
+    bool forProfiling = options.debugInfoForProfiling;
+    if (!options.profileGenerate.empty()) {
+        return PGOOptions(options.profileGenerate, "", "", PGOOptions::IRInstr, PGOOptions::NoCSAction, forProfiling);
+    }
+    if (!options.profileUse.empty()) {
+        // The pass would only report an unusable profile as a fatal diagnostic.
+        auto reader = IndexedInstrProfReader::create(options.profileUse);
+        if (!reader) {
+            throw clpl::CompileError("Unable to read profile '" + options.profileUse + "': " + toString(reader.takeError()) + ".");
+        }
+        if (!(*reader)->isIRLevelProfile()) {
+            throw clpl::CompileError("Profile '" + options.profileUse + "' was not collected with -fprofile-generate.");
+        }
+        return PGOOptions(options.profileUse, "", "", PGOOptions::IRUse, PGOOptions::NoCSAction, forProfiling);
+    }
+    if (!options.profileSampleUse.empty()) {
+        auto reader = SampleProfileReader::create(options.profileSampleUse, context);
+        std::error_code EC = reader ? (*reader)->read() : reader.getError();
+        if (EC) throw clpl::CompileError("Unable to read sample profile '" + options.profileSampleUse + "': " + EC.message() + ".");
+        return PGOOptions(options.profileSampleUse, "", "", PGOOptions::SampleUse, PGOOptions::NoCSAction, forProfiling);
+    }
+    if (forProfiling) return PGOOptions("", "", "", PGOOptions::NoAction, PGOOptions::NoCSAction, true);
+    return None;
+}
+
+static OptimizationLevel toOptimizationLevel(unsigned optLevel) {
+    switch (optLevel) {
+        case 0: return OptimizationLevel::O0;
+        case 1: return OptimizationLevel::O1;
+        case 2: return OptimizationLevel::O2;
+        default: return OptimizationLevel::O3;
+    }
+}
+
+Compiler::Compiler(const char *fname, const SList &statements, const CompileOptions &options) : statements(statements), options(options), mod(fname, context), builder(context), constants([this](const TypeSP &type) { return getType(type); }) {
     typemap = {
         {"void", builder.getVoidTy()},
         {"bool", builder.getInt1Ty()},
@@ -33,8 +108,29 @@ Compiler::Compiler(const char *fname, const SList &statements) : statements(stat
         {"f64", builder.getDoubleTy()},
         {"ptr", builder.getPtrTy()}
     };
+
+    if (!options.incrementalDir.empty() && options.lto == LTOMode::None && !options.profileGuided()) {
+        functionCache = std::make_unique<FunctionCache>(options.incrementalDir);
+    }
+
+    if (options.tracksLocations()) {
+        debugInfo = std::make_unique<DebugInfo>(mod, fname, options.compilationDir, options.debugInfo, options.optLevel > 0, options.debugInfoForProfiling);
+    }
+
+    auto handler = std::make_unique<RemarkHandler>(options, fname, functionLines);
+    remarkHandler = handler.get();
+    context.setDiagnosticHandler(std::move(handler));
+
+    // Early simplification needs the data layout before any function is generated.
+    if (options.pipeline) {
+        auto *targetMachine = getNativeTargetMachine();
+        mod.setTargetTriple(targetMachine->getTargetTriple().str());
+        mod.setDataLayout(targetMachine->createDataLayout());
+    }
 }
 
+Compiler::~Compiler() = default;
+
 llvm::Type *Compiler::getType(const clpl::TypeSP &type) {
     if (instanceof<NamedType>(type)) {
         return typemap.at(downcast<NamedType>(type)->name.identName);
@@ -42,39 +138,138 @@ llvm::Type *Compiler::getType(const clpl::TypeSP &type) {
     else if (instanceof<PointerType>(type) || instanceof<FunctionReferenceType>(type)) {
         return typemap.at("ptr");
     }
-    throw 1;
+    throw CompileError("Unsupported type '" + type->toString() + "'.");
 }
 
-void Compiler::output(const char *outpath) {
-    llvm::TargetOptions opts;
+FunctionType *Compiler::getFunctionType(const FunctionReferenceType &type) {
+    auto name = type.toString();
+    if (auto it = functionTypes.find(name); it != functionTypes.end()) return it->second;
+
+    std::vector<llvm::Type*> argtypes;
+    for (auto &i : type.argTypes) argtypes.push_back(getType(i));
+    auto *ftype = FunctionType::get(getType(type.returnType), argtypes, false);
+    functionTypes.insert({name, ftype});
+    return ftype;
+}
+
+// Integers of one width share a node whatever their signedness, as in C. Bytes are C's char, which
+// aliases everything, so byte buffers stay safe to pass to and from C code. An untyped ptr is C's
+// void *, stored and loaded in place of any other pointer.
+static std::string tbaaName(const clpl::TypeSP &type) {
+    if (instanceof<clpl::NamedType>(type)) {
+        auto name = downcast<clpl::NamedType>(type)->name.identName;
+        if (name == "i8" || name == "u8") return "char";
+        if (name == "ptr") return "any pointer";
+        if (name[0] == 'u') name[0] = 'i';
+        return name;
+    }
+    if (instanceof<clpl::PointerType>(type)) {
+        auto pointee = tbaaName(downcast<clpl::PointerType>(type)->dataType);
+        if (pointee != "void") return pointee + "*";
+    }
+    return "any pointer";
+}
+
+// Scalar type nodes under one root: pointers below "any pointer" by pointee type, everything else
+// below char.
+MDNode *Compiler::tbaaType(const TypeSP &type) {
+    MDBuilder md(context);
+    if (tbaaTypes.empty()) {
+        auto *chars = md.createTBAAScalarTypeNode("omnipotent char", md.createTBAARoot("clpl TBAA"));
+        tbaaTypes["char"] = chars;
+        tbaaTypes["any pointer"] = md.createTBAAScalarTypeNode("any pointer", chars);
+    }
 
-    InitializeNativeTarget();
-    InitializeNativeTargetAsmPrinter();
+    auto name = tbaaName(type);
+    if (auto it = tbaaTypes.find(name); it != tbaaTypes.end()) return it->second;
+    auto *parent = tbaaTypes.at(name.back() == '*' ? "any pointer" : "char");
+    auto *node = md.createTBAAScalarTypeNode(name, parent);
+    tbaaTypes.insert({name, node});
+    return node;
+}
 
-    auto fpm = std::make_unique<legacy::FunctionPassManager>(&mod);
-    fpm->add(llvm::createBasicAAWrapperPass());
-    fpm->add(llvm::createPromoteMemoryToRegisterPass());
-    fpm->add(llvm::createInstructionCombiningPass());
-    fpm->add(llvm::createReassociatePass());
-    fpm->add(llvm::createNewGVNPass());
-    fpm->add(llvm::createCFGSimplificationPass());
-    fpm->doInitialization();
+LoadInst *Compiler::load(const TypeSP &type, Value *address) {
+    auto *inst = builder.CreateLoad(getType(type), address);
+    if (options.emitsTBAA()) {
+        auto *node = tbaaType(type);
+        inst->setMetadata(LLVMContext::MD_tbaa, MDBuilder(context).createTBAAStructTagNode(node, node, 0));
+    }
+    return inst;
+}
 
-    auto targetTriple = LLVMGetDefaultTargetTriple();
-    mod.setTargetTriple(targetTriple);
+StoreInst *Compiler::store(Value *value, Value *address, const TypeSP &type) {
+    auto *inst = builder.CreateStore(value, address);
+    if (options.emitsTBAA()) {
+        auto *node = tbaaType(type);
+        inst->setMetadata(LLVMContext::MD_tbaa, MDBuilder(context).createTBAAStructTagNode(node, node, 0));
+    }
+    return inst;
+}
 
-    std::string error;
-    auto target = TargetRegistry::lookupTarget(targetTriple, error);
+// Every slot is allocated once in the entry block, where mem2reg and SROA look for them, even for a
+// local declared in a loop. Slots share stack space through lifetime markers instead.
+AllocaInst *Compiler::createSlot(llvm::Type *type) {
+    auto &entry = parent->getEntryBlock();
+    IRBuilder<> slots(&entry, lastSlot != nullptr ? std::next(lastSlot->getIterator()) : entry.begin());
+    lastSlot = slots.CreateAlloca(type);
+    return lastSlot;
+}
 
-    auto CPU = "generic";
-    auto features = "";
+void Compiler::endScopes(size_t depth) {
+    // Like clang, only optimized code marks lifetimes.
+    if (options.optLevel == 0) return;
+    for (size_t i = scopes.size(); i-- > depth;) {
+        for (auto it = scopes[i].rbegin(); it != scopes[i].rend(); ++it) builder.CreateLifetimeEnd(*it);
+    }
+}
 
-    auto RM = Optional<Reloc::Model>();
-    auto targetMachine = target->createTargetMachine(targetTriple, CPU, features, opts, RM);
-    mod.setDataLayout(targetMachine->createDataLayout());
+void Compiler::setLocation(int line, int column) {
+    if (debugInfo == nullptr || line == 0) return;
+    builder.SetCurrentDebugLocation(debugInfo->location(line, column));
+}
 
+void Compiler::output(const char *outpath) {
     std::error_code EC;
     raw_fd_ostream dest(outpath, EC);
+    if (EC) throw CompileError("Unable to open '" + std::string(outpath) + "': " + EC.message());
+    output(dest);
+}
+
+void Compiler::output(raw_pwrite_stream &dest) {
+    auto *targetMachine = getNativeTargetMachine();
+    mod.setTargetTriple(targetMachine->getTargetTriple().str());
+    mod.setDataLayout(targetMachine->createDataLayout());
+
+    if (!options.optRecordFile.empty()) {
+        auto file = setupLLVMOptimizationRemarks(context, options.optRecordFile, "", options.optRecordFormat, false);
+        if (!file) throw CompileError("Unable to save optimization remarks: " + toString(file.takeError()));
+        optRecord = std::move(*file);
+    }
+
+    if (debugInfo != nullptr) debugInfo->finalize();
+    if (options.instrument != InstrumentKind::None) emitRuntimeHook();
+
+    if (memory != nullptr) {
+        memory->recordSymbolTable("compiler globals", globals.size());
+        memory->recordSymbolTable("compiler functions", functions.size());
+        memory->recordSymbolTable("compiler types", typemap.size());
+        memory->recordModule("after IR generation", mod);
+    }
+
+    {
+        PhaseScope scope(timers, Phase::Optimization, memory);
+        optimize(targetMachine);
+        linkCachedFunctions();
+        if (functionCache != nullptr) optimizeLinked(targetMachine);
+    }
+    if (memory != nullptr) memory->recordModule("after optimization", mod);
+
+    PhaseScope scope(timers, Phase::CodeGeneration, memory);
+    if (options.lto != LTOMode::None) {
+        emitBitcode(dest);
+        if (optRecord != nullptr) optRecord->keep();
+        return;
+    }
 
     legacy::PassManager pass;
 
@@ -82,16 +277,206 @@ void Compiler::output(const char *outpath) {
 
     pass.run(mod);
     dest.flush();
+    if (optRecord != nullptr) optRecord->keep();
+}
+
+// Inlining followed by a light cleanup of the callers, for functions that were simplified
+// on their own beforehand.
+static ModuleInlinerWrapperPass buildCleanupInliner(unsigned optLevel) {
+    ModuleInlinerWrapperPass inliner(getInlineParams(optLevel, 0), true);
+    FunctionPassManager cleanup;
+    cleanup.addPass(SROAPass());
+    cleanup.addPass(EarlyCSEPass(true));
+    cleanup.addPass(InstCombinePass());
+    cleanup.addPass(SimplifyCFGPass());
+    inliner.getPM().addPass(createCGSCCToFunctionPassAdaptor(std::move(cleanup)));
+    return inliner;
+}
+
+void Compiler::optimize(TargetMachine *targetMachine) {
+    PassContext passes(targetMachine, timers, toPGOOptions(options, context));
+    auto &pb = passes.pb;
+    auto level = toOptimizationLevel(options.optLevel);
+
+    if (functionCache != nullptr) {
+        optimizeFunctions(passes, level);
+        return;
+    }
+
+    ModulePassManager mpm;
+    if (level == OptimizationLevel::O0) {
+        mpm = pb.buildO0DefaultPipeline(level, options.lto != LTOMode::None);
+    }
+    else if (options.lto == LTOMode::Thin) {
+        mpm = pb.buildThinLTOPreLinkDefaultPipeline(level);
+    }
+    else if (options.lto == LTOMode::Full) {
+        mpm = pb.buildLTOPreLinkDefaultPipeline(level);
+    }
+    else if (earlyPasses != nullptr) {
+        // -fpipeline already simplified every function, so only inline and clean up after it
+        // before the module optimizations.
+        mpm.addPass(buildCleanupInliner(options.optLevel));
+        mpm.addPass(pb.buildModuleOptimizationPipeline(level, ThinOrFullLTOPhase::None));
+    }
+    else {
+        mpm = pb.buildPerModuleDefaultPipeline(level);
+    }
+    mpm.run(mod, passes.mam);
+}
+
+// Incremental builds optimize each function on its own so that cached bodies stay valid
+// regardless of what happens to their callers and callees.
+void Compiler::optimizeFunctions(PassContext &passes, OptimizationLevel level) {
+    if (level != OptimizationLevel::O0) {
+        passes.fpm = passes.pb.buildFunctionSimplificationPipeline(level, ThinOrFullLTOPhase::None);
+    }
+
+    for (auto &[key, func] : freshFunctions) {
+        passes.fpm.run(*func, passes.fam);
+        functionCache->store(key, *func);
+    }
+}
+
+// Cached and fresh bodies only meet once linked, so inlining across them and dropping the
+// functions that became unused happen here, without touching what the cache holds.
+void Compiler::optimizeLinked(TargetMachine *targetMachine) {
+    if (options.optLevel == 0) return;
+    PassContext passes(targetMachine, timers);
+    ModulePassManager mpm;
+    mpm.addPass(buildCleanupInliner(options.optLevel));
+    mpm.addPass(GlobalDCEPass());
+    mpm.run(mod, passes.mam);
+}
+
+void Compiler::linkCachedFunctions() {
+    if (cachedFunctions.empty()) return;
+
+    // Cached bodies declare the globals they use, which only resolve against external definitions,
+    // so the program's globals are external just while linking.
+    std::vector<GlobalVariable*> internal;
+    for (auto &gv : mod.globals()) {
+        if (gv.hasInternalLinkage()) internal.push_back(&gv);
+    }
+    for (auto *gv : internal) gv->setLinkage(GlobalValue::ExternalLinkage);
+    for (auto &m : cachedFunctions) {
+        if (Linker::linkModules(mod, std::move(m))) throw CompileError("Unable to link a cached function body.");
+    }
+    for (auto *gv : internal) gv->setLinkage(GlobalValue::InternalLinkage);
+    cachedFunctions.clear();
+}
+
+void Compiler::emitBitcode(raw_pwrite_stream &dest) {
+    if (options.lto == LTOMode::Thin) {
+        ProfileSummaryInfo psi(mod);
+        auto index = buildModuleSummaryIndex(mod, nullptr, &psi);
+        WriteBitcodeToFile(mod, dest, false, &index);
+    }
+    else {
+        mod.addModuleFlag(Module::Error, "ThinLTO", uint32_t(0));
+        WriteBitcodeToFile(mod, dest);
+    }
+    dest.flush();
+}
+
+// Counts the call in a record laid out like struct clplrt_counter, which the linker gathers
+// into the clpl_counters section for the runtime to find.
+void Compiler::instrumentEntry(Function *func) {
+    auto *i64 = builder.getInt64Ty();
+    auto *type = StructType::getTypeByName(context, "clplrt_counter");
+    if (type == nullptr) type = StructType::create(context, {i64, i64, typemap.at("ptr")}, "clplrt_counter");
+
+    auto *name = builder.CreateGlobalStringPtr(func->getName(), "", 0, &mod);
+    auto *init = ConstantStruct::get(type, {ConstantInt::get(i64, 0), ConstantInt::get(i64, 0), name});
+    counter = new GlobalVariable(mod, type, false, GlobalValue::PrivateLinkage, init, "__clpl_counter_" + func->getName());
+    counter->setSection("clpl_counters");
+    counter->setAlignment(Align(8));
+    appendToCompilerUsed(mod, {counter});
+
+    auto *calls = builder.CreateStructGEP(type, counter, 0);
+    builder.CreateStore(builder.CreateAdd(builder.CreateLoad(i64, calls), ConstantInt::get(i64, 1)), calls);
+    if (options.instrument == InstrumentKind::Cycles) {
+        entryCycles = builder.CreateIntrinsic(Intrinsic::readcyclecounter, {}, {});
+    }
+}
+
+// Every return goes through returnBlock, so this is the only exit to account for.
+void Compiler::instrumentReturn() {
+    if (entryCycles != nullptr) {
+        auto *i64 = builder.getInt64Ty();
+        auto *elapsed = builder.CreateSub(builder.CreateIntrinsic(Intrinsic::readcyclecounter, {}, {}), entryCycles);
+        auto *cycles = builder.CreateStructGEP(counter->getValueType(), counter, 1);
+        builder.CreateStore(builder.CreateAdd(builder.CreateLoad(i64, cycles), elapsed), cycles);
+    }
+    counter = nullptr;
+    entryCycles = nullptr;
+}
+
+// Linking against libclplrt.a only pulls in the runtime if something refers to it.
+void Compiler::emitRuntimeHook() {
+    auto *i32 = builder.getInt32Ty();
+    auto *flag = new GlobalVariable(mod, i32, false, GlobalValue::ExternalLinkage, nullptr, "clplrt_counters_runtime");
+
+    auto *user = Function::Create(FunctionType::get(i32, false), GlobalValue::LinkOnceODRLinkage, "__clplrt_runtime_user", mod);
+    user->setVisibility(GlobalValue::HiddenVisibility);
+    user->setComdat(mod.getOrInsertComdat(user->getName()));
+    IRBuilder<> hook(BasicBlock::Create(context, "", user));
+    hook.CreateRet(hook.CreateLoad(i32, flag));
+    appendToCompilerUsed(mod, {user});
 }
 
 void Compiler::compile() {
     for (const auto &i : statements) {
-        compileStatement(i);
+        compileTopLevel(i);
+    }
+}
+
+void Compiler::setPhaseTimers(PhaseTimers *phaseTimers) {
+    timers = phaseTimers;
+}
+
+void Compiler::setMemoryReport(MemoryReport *memoryReport) {
+    memory = memoryReport;
+}
+
+void Compiler::compileTopLevel(const StmtSP &s) {
+    {
+        PhaseScope scope(timers, Phase::IRGeneration, memory);
+        compileStatement(s);
     }
-    mod.dump();
+
+    // Incremental builds already simplify every fresh function on its own, PGO has to see
+    // functions the way the standard pipeline does, and LTO simplifies them again at link time.
+    if (!options.pipeline || options.optLevel == 0 || functionCache != nullptr || options.profileGuided() || options.lto != LTOMode::None || !instanceof<FuncDeclStmt>(s)) return;
+    auto *func = mod.getFunction(downcast<FuncDeclStmt>(s)->name.identName);
+    if (func == nullptr || func->isDeclaration()) return;
+
+    PhaseScope scope(timers, Phase::Optimization, memory);
+    if (earlyPasses == nullptr) {
+        earlyPasses = std::make_unique<PassContext>(getNativeTargetMachine(), timers);
+        earlyPasses->fpm = earlyPasses->pb.buildFunctionSimplificationPipeline(toOptimizationLevel(options.optLevel), ThinOrFullLTOPhase::None);
+    }
+    earlyPasses->fpm.run(*func, earlyPasses->fam);
+}
+
+void Compiler::print(raw_ostream &os) const {
+    mod.print(os, nullptr);
+}
+
+std::string Compiler::remarks() const {
+    return remarkHandler->remarks();
+}
+
+const std::vector<clpl::RemarkHandler::Message> &Compiler::backendDiagnostics() const {
+    return remarkHandler->diagnostics();
 }
 
 void Compiler::compileStatement(const StmtSP &s) {
+    // Whatever the statement ends with (a loop's back edge, say) belongs to the statement itself.
+    auto outer = builder.getCurrentDebugLocation();
+    auto restore = make_scope_exit([&] { builder.SetCurrentDebugLocation(outer); });
+    if (s != nullptr) setLocation(s->line, s->column);
+
     if (instanceof<BlockStmt>(s)) compileBlock(s);
     else if (instanceof<ExprStmt>(s)) compileExprStmt(s);
     else if (instanceof<FuncDeclStmt>(s)) compileFunction(s);
@@ -102,15 +487,20 @@ void Compiler::compileStatement(const StmtSP &s) {
     else if (instanceof<ForStmt>(s)) compileFor(s);
     else if (instanceof<BreakStmt>(s)) compileBreak(s);
     else if (instanceof<ContinueStmt>(s)) compileContinue(s);
-    else throw 1;
+    else throw CompileError("Unsupported statement.");
 }
 
 void Compiler::compileBlock(const StmtSP &s) {
     auto st = downcast<BlockStmt>(s);
 
+    if (debugInfo != nullptr) debugInfo->beginBlock(*st);
+    scopes.emplace_back();
     for (const auto &i : st->statements) {
         compileStatement(i);
     }
+    endScopes(scopes.size() - 1);
+    scopes.pop_back();
+    if (debugInfo != nullptr) debugInfo->endBlock();
 }
 
 void Compiler::compileExprStmt(const StmtSP &s) {
@@ -120,6 +510,7 @@ void Compiler::compileExprStmt(const StmtSP &s) {
 
 void Compiler::compileFunction(const StmtSP &s) {
     auto funcs = downcast<FuncDeclStmt>(s);
+    TimeTraceScope trace("IRGenFunction", funcs->name.identName);
     auto rtype = getType(funcs->type);
 
     std::vector<llvm::Type*> paramtypes;
@@ -128,33 +519,70 @@ void Compiler::compileFunction(const StmtSP &s) {
     }
 
     auto ftype = FunctionType::get(rtype, paramtypes, false);
-    auto *func = Function::Create(ftype, Function::ExternalLinkage, funcs->name.identName, this->mod);
-    globals.insert({{funcs->name.identName, func}});
+    // A definition completes an earlier prototype rather than adding a second function.
+    Function *func;
+    if (auto it = functions.find(funcs->name.identName); it != functions.end()) {
+        func = it->second;
+        if (func->getFunctionType() != ftype) throw CompileError("Conflicting types for function '" + funcs->name.identName + "'.");
+    }
+    else {
+        func = Function::Create(ftype, Function::ExternalLinkage, funcs->name.identName, this->mod);
+        functions.insert({funcs->name.identName, func});
+    }
+    constants.defineFunction(funcs, func);
+    for (unsigned i = 0; i < funcs->params.size(); i++) {
+        auto &param = funcs->params[i];
+        if (param.restrict) func->addParamAttr(i, Attribute::NoAlias);
+        if (param.nocapture) func->addParamAttr(i, Attribute::NoCapture);
+        if (param.readonly) func->addParamAttr(i, Attribute::ReadOnly);
+    }
+    functionLines[funcs->name.identName] = funcs->name.line;
     if (funcs->body == nullptr) return;
+    // The sample profile loader skips functions without it.
+    if (!options.profileSampleUse.empty()) func->addFnAttr("use-sample-profile");
+
+    if (functionCache != nullptr) {
+        auto key = FunctionCache::fingerprint(*funcs, mod.getName(), options);
+        if (auto cached = functionCache->load(key, context)) {
+            cachedFunctions.push_back(std::move(cached));
+            return;
+        }
+        freshFunctions.push_back({key, func});
+    }
 
 
-    for (size_t i = 0; i < func->arg_size(); i++) {
-        auto name = funcs->params[i].name.identName;
-        auto *val = func->getArg(i);
-        arguments.insert({{name, val}});
-    }
+    // The prologue and epilogue are attributed to the declaration.
+    if (debugInfo != nullptr) debugInfo->beginFunction(func, *funcs);
+    setLocation(funcs->line, funcs->column);
 
     auto *entry = BasicBlock::Create(context, "", func);
     returnBlock = BasicBlock::Create(context, "", func);
     builder.SetInsertPoint(entry);
+    parent = func;
+    lastSlot = nullptr;
+
+    // Parameters live in slots like locals, so that they can be assigned to.
+    for (size_t i = 0; i < func->arg_size(); i++) {
+        auto &param = funcs->params[i];
+        auto *slot = createSlot(getType(param.type));
+        store(func->getArg(i), slot, param.type);
+        localvars.insert({param.name.identName, slot});
+        if (debugInfo != nullptr) debugInfo->declareParameter(slot, i, param, builder);
+    }
+    if (options.instrument != InstrumentKind::None) instrumentEntry(func);
 
     if (!rtype->isVoidTy()) {
-        returnValue = builder.CreateAlloca(rtype, ConstantInt::get(typemap.at("i32"), 1));
+        returnValue = createSlot(rtype);
     }
 
     isOnGlobalScope = false;
-    parent = func;
     compileBlock(funcs->body);
     builder.CreateBr(returnBlock);
 
     builder.SetInsertPoint(returnBlock);
+    if (options.instrument != InstrumentKind::None) instrumentReturn();
     if (!rtype->isVoidTy()) {
-        auto *val = builder.CreateLoad(rtype, returnValue);
+        auto *val = load(funcs->type, returnValue);
         builder.CreateRet(val);
     }
     else {
@@ -164,29 +592,62 @@ void Compiler::compileFunction(const StmtSP &s) {
     parent = nullptr;
     isOnGlobalScope = true;
     localvars.clear();
-    arguments.clear();
+    if (debugInfo != nullptr) debugInfo->endFunction();
 }
 
 void Compiler::compileVarDecl(const StmtSP &s) {
+    if (isOnGlobalScope) return compileGlobalVar(s);
     auto vards = downcast<VarDeclStmt>(s);
 
-    auto size = ConstantInt::get(builder.getInt32Ty(), 1);
-    auto var = builder.CreateAlloca(getType(vards->type), size);
+    auto *var = createSlot(getType(vards->type));
+    if (options.optLevel > 0) builder.CreateLifetimeStart(var);
+    scopes.back().push_back(var);
 
-    if (isOnGlobalScope) globals.insert_or_assign(vards->name.identName, var);
-    else localvars.insert_or_assign(vards->name.identName, var);
+    localvars.insert_or_assign(vards->name.identName, var);
+    if (debugInfo != nullptr) debugInfo->declareLocal(var, *vards, builder);
 
     if (vards->value != nullptr) {
-        builder.CreateStore(compileExpression(vards->value), var);
+        store(convert(compileExpression(vards->value), vards->value->type->isSigned(), getType(vards->type)), var, vards->type);
     }
 }
 
+// Globals are static data: the initializer is evaluated now, so nothing runs at startup.
+void Compiler::compileGlobalVar(const StmtSP &s) {
+    auto vards = downcast<VarDeclStmt>(s);
+    auto &name = vards->name.identName;
+    auto *type = getType(vards->type);
+
+    Constant *init = Constant::getNullValue(type);
+    if (vards->value != nullptr) {
+        auto *value = compileConstant(vards->value);
+        if (value == nullptr) throw CompileError("Initializer of global '" + name + "' is not a constant expression.");
+        init = ConstEvaluator::convert(value, vards->value->type->isSigned(), type);
+        if (init == nullptr) throw CompileError("Initializer of global '" + name + "' does not match its type.");
+    }
+
+    auto *var = new GlobalVariable(mod, type, false, GlobalValue::InternalLinkage, init, name);
+    globals.insert_or_assign(name, var);
+    constants.defineGlobal(name, init);
+    if (debugInfo != nullptr) debugInfo->declareGlobal(var, *vards);
+}
+
+Constant *Compiler::compileConstant(const ExprSP &e) {
+    // Strings and arrays are globals of their own, which the evaluator doesn't create.
+    bool isString = instanceof<LiteralExpr>(e) && downcast<LiteralExpr>(e)->val.type == TokenT::STRING_LIT;
+    if (isString || instanceof<ArrayLiteralExpr>(e)) return cast<Constant>(compileExpression(e));
+    return constants.evaluate(e);
+}
+
 void Compiler::compileReturn(const StmtSP &s) {
     auto rets = downcast<ReturnStmt>(s);
     if (rets->value != nullptr) {
-        builder.CreateStore(compileExpression(rets->value), returnValue);
+        store(compileExpression(rets->value), returnValue, rets->value->type);
     }
+    endScopes(0);
     builder.CreateBr(returnBlock);
+
+    auto *next = BasicBlock::Create(context, "", parent);
+    builder.SetInsertPoint(next);
 }
 
 void Compiler::compileIf(const StmtSP &s) {
@@ -225,9 +686,11 @@ void Compiler::compileWhile(const StmtSP &s) {
 
     auto *prevCond = innermostCondition;
     auto *prevExit = innermostExit;
+    auto prevScopes = innermostScopes;
 
     innermostCondition = condBlock;
     innermostExit = exitBlock;
+    innermostScopes = scopes.size();
 
     builder.SetInsertPoint(currentBlock);
     builder.CreateBr(condBlock);
@@ -244,6 +707,7 @@ void Compiler::compileWhile(const StmtSP &s) {
 
     innermostCondition = prevCond;
     innermostExit = prevExit;
+    innermostScopes = prevScopes;
 }
 
 void Compiler::compileFor(const StmtSP &s) {
@@ -257,9 +721,13 @@ void Compiler::compileFor(const StmtSP &s) {
 
     auto *prevCond = innermostCondition;
     auto *prevExit = innermostExit;
+    auto prevScopes = innermostScopes;
 
+    // The scope of a variable declared by the initializer.
+    scopes.emplace_back();
     innermostCondition = condBlock;
     innermostExit = exitBlock;
+    innermostScopes = scopes.size();
 
     builder.SetInsertPoint(currentBlock);
     compileStatement(fors->init);
@@ -275,9 +743,12 @@ void Compiler::compileFor(const StmtSP &s) {
     builder.CreateBr(condBlock);
 
     builder.SetInsertPoint(exitBlock);
+    endScopes(scopes.size() - 1);
+    scopes.pop_back();
 
     innermostCondition = prevCond;
     innermostExit = prevExit;
+    innermostScopes = prevScopes;
 }
 
 void Compiler::compileBreak(const StmtSP &s) {
@@ -287,6 +758,7 @@ void Compiler::compileBreak(const StmtSP &s) {
 
     builder.CreateBr(brb);
     builder.SetInsertPoint(brb);
+    endScopes(innermostScopes);
     builder.CreateBr(innermostExit);
 
     auto *next = BasicBlock::Create(context, "", parent);
@@ -300,6 +772,7 @@ void Compiler::compileContinue(const StmtSP &s) {
 
     builder.CreateBr(brb);
     builder.SetInsertPoint(brb);
+    endScopes(innermostScopes);
     builder.CreateBr(innermostCondition);
 
     auto *next = BasicBlock::Create(context, "", parent);
@@ -307,6 +780,11 @@ void Compiler::compileContinue(const StmtSP &s) {
 }
 
 Value *Compiler::compileExpression(const ExprSP &expr, bool isLvalue) {
+    // Operands restore the location of the operation they feed once generated.
+    auto outer = builder.getCurrentDebugLocation();
+    auto restore = make_scope_exit([&] { builder.SetCurrentDebugLocation(outer); });
+    if (expr != nullptr) setLocation(expr->line, expr->column);
+
     if (instanceof<LiteralExpr>(expr)) return compileLiteral(expr);
     else if (instanceof<IdentifierExpr>(expr)) return compileIdent(expr, isLvalue);
     else if (instanceof<UnaryExpr>(expr)) return compileUnary(expr);
@@ -314,6 +792,8 @@ Value *Compiler::compileExpression(const ExprSP &expr, bool isLvalue) {
     else if (instanceof<GroupExpr>(expr)) return compileGroup(expr);
     else if (instanceof<AssignExpr>(expr)) return compileAssign(expr);
     else if (instanceof<CallExpr>(expr)) return compileCall(expr);
+    else if (instanceof<ArrayLiteralExpr>(expr)) return compileArrayLiteral(expr);
+    else if (instanceof<IndexExpr>(expr)) return compileIndex(expr, isLvalue);
     return nullptr;
 }
 
@@ -330,14 +810,16 @@ Value *Compiler::compileLiteral(const ExprSP &expr) {
         case TokenT::DOUBLE_LIT:
             return ConstantFP::get(getType(lexp->type), lexp->val.doubleValue);
         case TokenT::STRING_LIT: {
-            std::vector<llvm::Constant*> chars (lexp->val.strValue.size() + 1);
-            for (unsigned int i = 0; i < lexp->val.strValue.size(); i++) {
-                chars[i] = ConstantInt::get(builder.getInt8Ty(), lexp->val.strValue[i]);
+            // Private unnamed_addr strings go to the mergeable string sections, so the linker
+            // shares them across objects too.
+            auto &pooled = strings[lexp->val.strValue];
+            if (pooled == nullptr) {
+                auto *init = ConstantDataArray::getString(context, lexp->val.strValue);
+                pooled = new GlobalVariable(mod, init->getType(), true, GlobalValue::PrivateLinkage, init, ".str");
+                pooled->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+                pooled->setAlignment(Align(1));
             }
-            chars[lexp->val.strValue.size()] = ConstantInt::get(builder.getInt8Ty(), '\0');
-            auto init = ConstantArray::get(ArrayType::get(builder.getInt8Ty(), chars.size()), chars);
-            auto *gv = new GlobalVariable(mod, init->getType(), true, GlobalValue::ExternalLinkage, init);
-            return ConstantExpr::getBitCast(gv, getType(lexp->type));
+            return pooled;
         }
         default:
             break;
@@ -350,14 +832,15 @@ Value *Compiler::compileIdent(const ExprSP &expr, bool isLvalue) {
 
     if (localvars.contains(iexp->ident.identName)) {
         if (isLvalue) return localvars.at(iexp->ident.identName);
-        else return builder.CreateLoad(getType(iexp->type), localvars.at(iexp->ident.identName));
+        else return load(iexp->type, localvars.at(iexp->ident.identName));
     }
     else if (globals.contains(iexp->ident.identName)) {
         if (isLvalue) return globals.at(iexp->ident.identName);
-        else return builder.CreateLoad(getType(iexp->type), globals.at(iexp->ident.identName));
+        else return load(iexp->type, globals.at(iexp->ident.identName));
     }
-    else if (arguments.contains(iexp->ident.identName)) {
-        return arguments.at(iexp->ident.identName);
+    // A function used as a value is its address.
+    else if (auto it = functions.find(iexp->ident.identName); it != functions.end()) {
+        return it->second;
     }
     return nullptr;
 }
@@ -367,10 +850,13 @@ Value *Compiler::compileUnary(const ExprSP &expr) {
 
     auto *type = getType(uexp->type);
     auto *subexp = compileExpression(uexp->expr);
+    if (auto *c = dyn_cast<Constant>(subexp)) {
+        if (auto *folded = ConstEvaluator::unary(uexp->op, c)) return folded;
+    }
 
     switch (uexp->op) {
         case TokenT::MINUS: {
-            if (type->isPointerTy()) throw 1;
+            if (type->isPointerTy()) throw CompileError("Cannot negate a pointer.");
             if (type->isIntegerTy()) return builder.CreateSub(ConstantInt::get(type, 0), subexp);
             return builder.CreateFSub(ConstantFP::get(type, 0), subexp);
         }
@@ -387,8 +873,13 @@ Value *Compiler::compileBinary(const ExprSP &expr) {
     auto *type = getType(bexp->type);
     bool isSigned = bexp->type->isSigned();
 
+    if (bexp->op == TokenT::AND || bexp->op == TokenT::OR) return compileLogical(expr);
+
     auto *lhs = compileExpression(bexp->left);
     auto *rhs = compileExpression(bexp->right);
+    if (isa<Constant>(lhs) && isa<Constant>(rhs)) {
+        if (auto *folded = ConstEvaluator::binary(bexp->op, isSigned, cast<Constant>(lhs), cast<Constant>(rhs))) return folded;
+    }
 
     switch (bexp->op) {
         case TokenT::PLUS: {
@@ -457,17 +948,36 @@ Value *Compiler::compileBinary(const ExprSP &expr) {
             }
             return builder.CreateFCmp(CmpInst::Predicate::FCMP_OLE, lhs, rhs);
         }
-        case TokenT::AND: {
-            return builder.CreateAnd(lhs, rhs);
-        }
-        case TokenT::OR: {
-            return builder.CreateOr(lhs, rhs);
-        }
         default:
             return nullptr;
     }
 }
 
+// The right operand of `and`/`or` is only evaluated when the left one doesn't decide the result.
+Value *Compiler::compileLogical(const ExprSP &expr) {
+    auto bexp = downcast<BinaryExpr>(expr);
+    bool isAnd = bexp->op == TokenT::AND;
+
+    auto *lhs = truthValue(compileExpression(bexp->left));
+    auto *lhsBlock = builder.GetInsertBlock();
+    auto *rhsBlock = BasicBlock::Create(context, "", parent);
+    auto *exitBlock = BasicBlock::Create(context, "", parent);
+    if (isAnd) builder.CreateCondBr(lhs, rhsBlock, exitBlock);
+    else builder.CreateCondBr(lhs, exitBlock, rhsBlock);
+
+    builder.SetInsertPoint(rhsBlock);
+    auto *rhs = truthValue(compileExpression(bexp->right));
+    // The right operand may have ended in a block of its own (a nested `and`/`or`).
+    rhsBlock = builder.GetInsertBlock();
+    builder.CreateBr(exitBlock);
+
+    builder.SetInsertPoint(exitBlock);
+    auto *phi = builder.CreatePHI(builder.getInt1Ty(), 2);
+    phi->addIncoming(builder.getInt1(!isAnd), lhsBlock);
+    phi->addIncoming(rhs, rhsBlock);
+    return phi;
+}
+
 Value *Compiler::compileGroup(const ExprSP &expr) {
     auto gexp = downcast<GroupExpr>(expr);
 
@@ -476,34 +986,115 @@ Value *Compiler::compileGroup(const ExprSP &expr) {
 
 Value *Compiler::compileAssign(const ExprSP &expr) {
     auto aexp = downcast<AssignExpr>(expr);
-    auto val = compileExpression(aexp->value);
+    auto val = convert(compileExpression(aexp->value), aexp->value->type->isSigned(), getType(aexp->target->type));
 
-    return builder.CreateStore(val, compileExpression(aexp->target, true));
+    return store(val, compileExpression(aexp->target, true), aexp->target->type);
 }
 
 Value *Compiler::compileCall(const ExprSP &expr) {
     auto cexp = downcast<CallExpr>(expr);
     Value *callee = nullptr;
+    FunctionType *ftype = nullptr;
     if (instanceof<IdentifierExpr>(cexp->callee)) {
-        for (auto &f : mod.functions()) {
-            if (f.getName() == downcast<IdentifierExpr>(cexp->callee)->ident.identName) {
-                callee = &f;
-                goto out;
-            }
+        if (auto it = functions.find(downcast<IdentifierExpr>(cexp->callee)->ident.identName); it != functions.end()) {
+            callee = it->second;
+            ftype = it->second->getFunctionType();
         }
-        callee = compileExpression(cexp->callee);
     }
-    else {
+    if (callee == nullptr) {
         callee = compileExpression(cexp->callee);
+        ftype = getFunctionType(*downcast<FunctionReferenceType>(cexp->callee->type));
     }
-    out:
+
     std::vector<llvm::Value*> argvalues;
-    std::vector<llvm::Type*> argtypes;
     for (auto &arg : cexp->args) {
-        auto *argval = compileExpression(arg);
-        argvalues.push_back(argval);
-        argtypes.push_back(getType(arg->type));
+        auto *value = compileExpression(arg);
+        if (argvalues.size() < ftype->getNumParams()) value = convert(value, arg->type->isSigned(), ftype->getParamType(argvalues.size()));
+        argvalues.push_back(value);
+    }
+
+    // Incremental builds would keep a folded result after the callee changed, and -O0 keeps every
+    // call so that it can be stepped into.
+    auto *func = dyn_cast<Function>(callee);
+    if (func != nullptr && functionCache == nullptr && options.optLevel > 0 && all_of(argvalues, [](Value *v) { return isa<Constant>(v); })) {
+        std::vector<Constant*> args;
+        for (auto *v : argvalues) args.push_back(cast<Constant>(v));
+        if (auto *folded = constants.call(func->getName().str(), args)) return folded;
     }
-    auto *ftype = FunctionType::get(getType(cexp->type), argtypes, false);
+
+    bool matches = argvalues.size() == ftype->getNumParams();
+    for (size_t i = 0; matches && i < argvalues.size(); i++) matches = argvalues[i]->getType() == ftype->getParamType(i);
+    if (!matches) throw CompileError("Arguments don't match the parameters of the called function.");
     return builder.CreateCall(ftype, callee, argvalues);
+}
+
+// At global scope a literal is a constant table, so loads from it at constant indices fold away,
+// unless it is marked mutable. Inside a function every evaluation copies it, rows included, to slots
+// of its own, like a local array in C; SROA still folds loads from the copy.
+Value *Compiler::compileArrayLiteral(const ExprSP &expr) {
+    auto aexp = downcast<ArrayLiteralExpr>(expr);
+    if (isOnGlobalScope) return arrayTable(expr, aexp->writable);
+
+    auto *table = arrayTable(expr, false);
+    auto *copy = createSlot(table->getValueType());
+    auto size = mod.getDataLayout().getTypeAllocSize(table->getValueType());
+    builder.CreateMemCpy(copy, copy->getAlign(), table, table->getAlign(), size.getFixedSize());
+
+    auto &elementType = downcast<IndexedPointerType>(aexp->type)->dataType;
+    for (size_t i = 0; i < aexp->elements.size(); i++) {
+        if (!instanceof<ArrayLiteralExpr>(aexp->elements[i])) continue;
+        auto *row = compileArrayLiteral(aexp->elements[i]);
+        store(row, builder.CreateConstInBoundsGEP2_64(table->getValueType(), copy, 0, i), elementType);
+    }
+    return copy;
+}
+
+GlobalVariable *Compiler::arrayTable(const ExprSP &expr, bool writable) {
+    auto aexp = downcast<ArrayLiteralExpr>(expr);
+    auto *elementType = getType(downcast<IndexedPointerType>(aexp->type)->dataType);
+
+    std::vector<Constant*> elements;
+    for (auto &e : aexp->elements) {
+        Constant *value = nullptr;
+        // Inside a function the rows are copied separately and stored over their slots.
+        if (instanceof<ArrayLiteralExpr>(e)) value = isOnGlobalScope ? arrayTable(e, writable) : Constant::getNullValue(elementType);
+        else if (isOnGlobalScope) value = compileConstant(e);
+        else value = dyn_cast<Constant>(compileExpression(e));
+        if (value == nullptr) throw CompileError("Array elements must be constant expressions.");
+        auto *element = ConstEvaluator::convert(value, e->type->isSigned(), elementType);
+        if (element == nullptr) throw CompileError("Array element does not match the element type '" + downcast<IndexedPointerType>(aexp->type)->dataType->toString() + "'.");
+        elements.push_back(element);
+    }
+
+    auto *init = ConstantArray::get(ArrayType::get(elementType, elements.size()), elements);
+    auto *table = new GlobalVariable(mod, init->getType(), !writable, GlobalValue::PrivateLinkage, init);
+    if (!writable) table->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+    return table;
+}
+
+// Indices are extended to 64 bits by their own signedness, like C's integer subscripts.
+Value *Compiler::compileIndex(const ExprSP &expr, bool isLvalue) {
+    auto iexp = downcast<IndexExpr>(expr);
+    auto *elementType = getType(iexp->type);
+
+    auto *base = compileExpression(iexp->target);
+    auto *index = builder.CreateIntCast(compileExpression(iexp->index), builder.getInt64Ty(), iexp->index->type->isSigned());
+    auto *address = builder.CreateInBoundsGEP(elementType, base, index);
+    if (isLvalue) return address;
+    return load(iexp->type, address);
+}
+
+Value *Compiler::convert(Value *value, bool isSigned, llvm::Type *type) {
+    auto *from = value->getType();
+    if (from == type || !(from->isIntegerTy() || from->isFloatingPointTy()) || !(type->isIntegerTy() || type->isFloatingPointTy())) return value;
+    return builder.CreateCast(CastInst::getCastOpcode(value, isSigned, type, isSigned), value, type);
+}
+
+Value *Compiler::truthValue(Value *value) {
+    auto *type = value->getType();
+    if (type->isIntegerTy(1)) return value;
+    if (type->isFloatingPointTy()) return builder.CreateFCmpUNE(value, ConstantFP::get(type, 0.0));
+    if (type->isPointerTy()) return builder.CreateIsNotNull(value);
+    if (type->isIntegerTy()) return builder.CreateICmpNE(value, ConstantInt::get(type, 0));
+    throw CompileError("Operands of 'and' and 'or' must be scalars.");
 }
\ No newline at end of file
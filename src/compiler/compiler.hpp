@@ -2,13 +2,103 @@
 
 #include <llvm/IR/Module.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/ToolOutputFile.h>
+#include <llvm/Target/TargetMachine.h>
 
 #include "../parser/parser.hpp"
+#include "consteval.hpp"
+#include "debuginfo.hpp"
+#include "incremental.hpp"
+#include "remarks.hpp"
 
 namespace clpl {
+    enum class LTOMode {
+        None,
+        Thin,
+        Full
+    };
+
+    enum class InstrumentKind {
+        None,
+        // Count the calls of every function.
+        Counters,
+        // Also sum the cycles spent in each function, callees included.
+        Cycles
+    };
+
+    struct CompileError : public std::exception {
+        std::string msg;
+        explicit CompileError(std::string msg) : msg(std::move(msg)) { }
+    };
+
+    struct CompileOptions {
+        unsigned optLevel = 0;
+        LTOMode lto = LTOMode::None;
+        // Reuse optimized IR of unchanged functions from this directory (ignored with LTO).
+        // Functions are simplified on their own and only inlined after linking, with no other
+        // interprocedural optimization, so code is slower than a normal build at -O2 and -O3.
+        std::string incrementalDir;
+        // Return the module as text in CompileResult::ir, before whole-module optimization.
+        bool dumpIR = false;
+        // Parse on a separate thread and simplify each function as soon as it is generated
+        // (without LTO); the module pipeline then only inlines and cleans up before optimizing.
+        bool pipeline = false;
+        // Report phase and pass timings in CompileResult::timeReport.
+        bool timeReport = false;
+        // Record a Chrome trace of the compile in CompileResult::timeTrace, dropping spans
+        // shorter than timeTraceGranularity microseconds.
+        bool timeTrace = false;
+        unsigned timeTraceGranularity = 500;
+        // Report memory use per phase and front end allocations in CompileResult::memReport.
+        bool memReport = false;
+        // Regexes over pass names (-Rpass, -Rpass-missed, -Rpass-analysis) selecting the
+        // optimization remarks returned in CompileResult::remarks.
+        std::string remarksPassed;
+        std::string remarksMissed;
+        std::string remarksAnalysis;
+        // Save every optimization remark to this file, as "yaml" or "bitstream".
+        std::string optRecordFile;
+        std::string optRecordFormat = "yaml";
+        DebugInfoKind debugInfo = DebugInfoKind::None;
+        // Directory that relative source names in debug info resolve against; the process's
+        // current directory when empty.
+        std::string compilationDir;
+        // Instrument for PGO; counts are written at exit to this .profraw path, which may use the
+        // %p/%m patterns of LLVM_PROFILE_FILE. Needs the profile runtime at link time.
+        std::string profileGenerate;
+        // Optimize with an indexed profile, as produced by llvm-profdata merge.
+        std::string profileUse;
+        // Optimize with a sample profile in any of LLVM's formats (e.g. converted from perf
+        // data of a -gline-tables-only build); samples are matched through debug locations.
+        std::string profileSampleUse;
+        // Add DWARF discriminators so that samples can tell apart code on the same line.
+        bool debugInfoForProfiling = false;
+        // Keep per-function records for the clplrt runtime to print (see runtime/clplrt.h).
+        InstrumentKind instrument = InstrumentKind::None;
+        // Tag memory accesses with their CLPL type at -O2 and up, so that accesses of different
+        // types are assumed not to alias.
+        bool strictAliasing = true;
+
+        bool remarksRequested() const {
+            return !remarksPassed.empty() || !remarksMissed.empty() || !remarksAnalysis.empty() || !optRecordFile.empty();
+        }
+        // Remarks need source locations even when no debug info is emitted.
+        bool tracksLocations() const { return debugInfo != DebugInfoKind::None || remarksRequested() || !profileSampleUse.empty(); }
+        // Profiles describe the whole module as the standard pipeline sees it, which rules out
+        // optimizing functions on their own (incremental builds, -fpipeline simplification).
+        bool profileGuided() const { return !profileGenerate.empty() || !profileUse.empty() || !profileSampleUse.empty(); }
+        bool emitsTBAA() const { return strictAliasing && optLevel >= 2; }
+    };
+
+    struct PassContext;
+    class PhaseTimers;
+    class MemoryReport;
+
     class Compiler {
         private:
             SList statements;
+            CompileOptions options;
             llvm::LLVMContext context;
             llvm::Module mod;
             llvm::IRBuilder<> builder;
@@ -17,17 +107,81 @@ namespace clpl {
             llvm::BasicBlock *returnBlock = nullptr;
             llvm::Value *returnValue;
             llvm::Function *parent = nullptr;
+            // Last stack slot put in the entry block of parent.
+            llvm::AllocaInst *lastSlot = nullptr;
+            // Locals of every enclosing scope, whose lifetimes end when it is left.
+            std::vector<std::vector<llvm::AllocaInst*>> scopes;
+            // Scopes outside the innermost loop, which break and continue don't leave.
+            size_t innermostScopes = 0;
 
             std::unordered_map<std::string, llvm::Type*> typemap;
-            std::unordered_map<std::string, llvm::Value*> globals, localvars, arguments;
+            std::unordered_map<std::string, llvm::Value*> globals, localvars;
+            // Every function declared so far, for resolving direct calls.
+            std::unordered_map<std::string, llvm::Function*> functions;
+            // Signatures of indirect calls, by the callee's type name.
+            std::unordered_map<std::string, llvm::FunctionType*> functionTypes;
+            ConstEvaluator constants;
+            // One global per distinct string literal.
+            std::unordered_map<std::string, llvm::GlobalVariable*> strings;
+            // !tbaa type nodes, by the name tbaaName() gives.
+            std::unordered_map<std::string, llvm::MDNode*> tbaaTypes;
             bool isOnGlobalScope = true;
 
+            std::unique_ptr<FunctionCache> functionCache;
+            std::vector<std::pair<std::string, llvm::Function*>> freshFunctions;
+            std::vector<std::unique_ptr<llvm::Module>> cachedFunctions;
+
+            std::unique_ptr<PassContext> earlyPasses;
+            PhaseTimers *timers = nullptr;
+            MemoryReport *memory = nullptr;
+
+            // Owned by the context.
+            RemarkHandler *remarkHandler = nullptr;
+            std::unordered_map<std::string, int> functionLines;
+            std::unique_ptr<llvm::ToolOutputFile> optRecord;
+            std::unique_ptr<DebugInfo> debugInfo;
+
+            // -finstrument record of the function being generated, and its cycle count at entry.
+            llvm::GlobalVariable *counter = nullptr;
+            llvm::Value *entryCycles = nullptr;
+
             llvm::Type *getType(const clpl::TypeSP &type);
+            llvm::FunctionType *getFunctionType(const FunctionReferenceType &type);
+            llvm::MDNode *tbaaType(const TypeSP &type);
+            // Accesses of CLPL values, tagged with their type when strict aliasing is on.
+            llvm::LoadInst *load(const TypeSP &type, llvm::Value *address);
+            llvm::StoreInst *store(llvm::Value *value, llvm::Value *address, const TypeSP &type);
+            llvm::AllocaInst *createSlot(llvm::Type *type);
+            // Ends the lifetimes of the locals in scopes from depth inward, at the insertion point.
+            void endScopes(size_t depth);
+            // Attributes the instructions generated next to a source position, with debug info on.
+            void setLocation(int line, int column);
+            void optimize(llvm::TargetMachine *targetMachine);
+            void optimizeFunctions(PassContext &passes, llvm::OptimizationLevel level);
+            void linkCachedFunctions();
+            void optimizeLinked(llvm::TargetMachine *targetMachine);
+            void emitBitcode(llvm::raw_pwrite_stream &dest);
+            void instrumentEntry(llvm::Function *func);
+            void instrumentReturn();
+            void emitRuntimeHook();
 
         public:
-            Compiler(const char *fname, const SList &statements);
+            Compiler(const char *fname, const SList &statements, const CompileOptions &options = {});
+            ~Compiler();
             void output(const char *outpath);
+            void output(llvm::raw_pwrite_stream &dest);
             void compile();
+            // Compiles one more top-level statement; compile() is a loop over this.
+            void compileTopLevel(const StmtSP &s);
+            // Accumulate -ftime-report phase timings into phaseTimers, which must outlive the Compiler.
+            void setPhaseTimers(PhaseTimers *phaseTimers);
+            // Same for -fmem-report statistics.
+            void setMemoryReport(MemoryReport *memoryReport);
+            void print(llvm::raw_ostream &os) const;
+            // Remarks selected by CompileOptions, available once output() is done.
+            std::string remarks() const;
+            // Warnings and errors LLVM reported, which it doesn't print itself.
+            const std::vector<RemarkHandler::Message> &backendDiagnostics() const;
 
         private:
             void compileStatement(const StmtSP &s);
@@ -35,6 +189,9 @@ namespace clpl {
             void compileExprStmt(const StmtSP &s);
             void compileFunction(const StmtSP &s);
             void compileVarDecl(const StmtSP &s);
+            void compileGlobalVar(const StmtSP &s);
+            // Value of a global initializer.
+            llvm::Constant *compileConstant(const ExprSP &e);
             void compileReturn(const StmtSP &s);
             void compileIf(const StmtSP &s);
             void compileWhile(const StmtSP &s);
@@ -47,8 +204,16 @@ namespace clpl {
             llvm::Value *compileIdent(const ExprSP &e, bool isLvalue = false);
             llvm::Value *compileUnary(const ExprSP &e);
             llvm::Value *compileBinary(const ExprSP &e);
+            llvm::Value *compileLogical(const ExprSP &e);
             llvm::Value *compileGroup(const ExprSP &e);
             llvm::Value *compileAssign(const ExprSP &e);
             llvm::Value *compileCall(const ExprSP &e);
+            llvm::Value *compileArrayLiteral(const ExprSP &e);
+            llvm::GlobalVariable *arrayTable(const ExprSP &e, bool writable);
+            llvm::Value *compileIndex(const ExprSP &e, bool isLvalue = false);
+            // Numeric conversion of a value stored to a variable or element of another type.
+            llvm::Value *convert(llvm::Value *value, bool isSigned, llvm::Type *type);
+            // Truth value of an operand of and/or, which may be any scalar: true when nonzero (non-null).
+            llvm::Value *truthValue(llvm::Value *value);
     };
 }
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include "consteval.hpp"
+
+#include <algorithm>
+
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/InstrTypes.h"
+
+using namespace llvm;
+using clpl::ConstEvaluator;
+
+// Bounds the work spent on one expression, so that a call that loops forever stays a runtime call,
+// and on all folded calls of a module together.
+static const size_t maxSteps = 1 << 18;
+static const size_t moduleSteps = 1 << 22;
+static const unsigned maxDepth = 64;
+
+// Folding scalars doesn't depend on the target's data layout.
+static const DataLayout &layout() {
+    static const DataLayout dl("");
+    return dl;
+}
+
+ConstEvaluator::ConstEvaluator(std::function<llvm::Type*(const TypeSP&)> getType) : getType(std::move(getType)), budget(moduleSteps) { }
+
+void ConstEvaluator::defineFunction(const FuncDeclStmtSP &decl, Function *func) {
+    addresses.insert_or_assign(decl->name.identName, func);
+    if (decl->body == nullptr) return;
+    bodies.insert_or_assign(decl->name.identName, decl);
+    // Calls that reached the prototype failed for lack of a body.
+    if (auto it = waiting.find(decl->name.identName); it != waiting.end()) {
+        for (auto &key : it->second) calls.erase(key);
+        waiting.erase(it);
+    }
+}
+
+void ConstEvaluator::defineGlobal(const std::string &name, Constant *value) {
+    globals.insert_or_assign(name, value);
+}
+
+Constant *ConstEvaluator::evaluate(const ExprSP &e) {
+    steps = 0;
+    limit = maxSteps;
+    return evaluate(e, nullptr);
+}
+
+Constant *ConstEvaluator::call(const std::string &name, const std::vector<Constant*> &args) {
+    steps = 0;
+    limit = std::min(maxSteps, budget);
+    auto *result = evaluateCall(name, args);
+    budget -= std::min(steps, budget);
+    return result;
+}
+
+Constant *ConstEvaluator::unary(TokenT op, Constant *operand) {
+    auto *type = operand->getType();
+    Constant *out = nullptr;
+    if (op == TokenT::MINUS && type->isIntegerTy()) {
+        out = ConstantFoldBinaryOpOperands(Instruction::Sub, ConstantInt::get(type, 0), operand, layout());
+    }
+    else if (op == TokenT::MINUS && type->isFloatingPointTy()) {
+        out = ConstantFoldBinaryOpOperands(Instruction::FSub, ConstantFP::get(type, 0), operand, layout());
+    }
+    else if (op == TokenT::NOT && type->isIntegerTy()) {
+        out = ConstantFoldBinaryOpOperands(Instruction::Xor, operand, Constant::getAllOnesValue(type), layout());
+    }
+    return out != nullptr && (isa<ConstantInt>(out) || isa<ConstantFP>(out)) ? out : nullptr;
+}
+
+Constant *ConstEvaluator::binary(TokenT op, bool isSigned, Constant *lhs, Constant *rhs) {
+    auto *type = lhs->getType();
+    if (type != rhs->getType() || !(type->isIntegerTy() || type->isFloatingPointTy())) return nullptr;
+    bool isFloat = type->isFloatingPointTy();
+
+    auto fold = [&](Instruction::BinaryOps intOp, Instruction::BinaryOps floatOp) {
+        return ConstantFoldBinaryOpOperands(isFloat ? floatOp : intOp, lhs, rhs, layout());
+    };
+    auto compare = [&](CmpInst::Predicate signedPred, CmpInst::Predicate unsignedPred, CmpInst::Predicate floatPred) {
+        return ConstantFoldCompareInstOperands(isFloat ? floatPred : isSigned ? signedPred : unsignedPred, lhs, rhs, layout());
+    };
+
+    Constant *out = nullptr;
+    switch (op) {
+        case TokenT::PLUS: out = fold(Instruction::Add, Instruction::FAdd); break;
+        case TokenT::MINUS: out = fold(Instruction::Sub, Instruction::FSub); break;
+        case TokenT::STAR: out = fold(Instruction::Mul, Instruction::FMul); break;
+        case TokenT::SLASH: out = fold(isSigned ? Instruction::SDiv : Instruction::UDiv, Instruction::FDiv); break;
+        case TokenT::MOD: out = fold(isSigned ? Instruction::SRem : Instruction::URem, Instruction::FRem); break;
+        case TokenT::EQ: out = compare(CmpInst::ICMP_EQ, CmpInst::ICMP_EQ, CmpInst::FCMP_OEQ); break;
+        case TokenT::NOT_EQ: out = compare(CmpInst::ICMP_NE, CmpInst::ICMP_NE, CmpInst::FCMP_ONE); break;
+        case TokenT::GT: out = compare(CmpInst::ICMP_SGT, CmpInst::ICMP_UGT, CmpInst::FCMP_OGT); break;
+        case TokenT::GEQ: out = compare(CmpInst::ICMP_SGE, CmpInst::ICMP_UGE, CmpInst::FCMP_OGE); break;
+        case TokenT::LT: out = compare(CmpInst::ICMP_SLT, CmpInst::ICMP_ULT, CmpInst::FCMP_OLT); break;
+        case TokenT::LEQ: out = compare(CmpInst::ICMP_SLE, CmpInst::ICMP_ULE, CmpInst::FCMP_OLE); break;
+        case TokenT::AND: if (!isFloat) out = fold(Instruction::And, Instruction::And); break;
+        case TokenT::OR: if (!isFloat) out = fold(Instruction::Or, Instruction::Or); break;
+        default: break;
+    }
+    // Division by zero and signed overflow of a division fold to poison, which stays a runtime trap.
+    return out != nullptr && (isa<ConstantInt>(out) || isa<ConstantFP>(out)) ? out : nullptr;
+}
+
+Constant *ConstEvaluator::convert(Constant *value, bool isSigned, llvm::Type *type) {
+    auto *from = value->getType();
+    if (from == type) return value;
+    if (!(from->isIntegerTy() || from->isFloatingPointTy()) || !(type->isIntegerTy() || type->isFloatingPointTy())) return nullptr;
+    return ConstantFoldCastOperand(CastInst::getCastOpcode(value, isSigned, type, isSigned), value, type, layout());
+}
+
+Constant *ConstEvaluator::evaluate(const ExprSP &e, Frame *frame) {
+    if (e == nullptr || ++steps > limit) return nullptr;
+
+    if (instanceof<LiteralExpr>(e)) {
+        auto lexp = downcast<LiteralExpr>(e);
+        switch (lexp->val.type) {
+            case TokenT::BOOL_LIT: return ConstantInt::getBool(getType(lexp->type), lexp->val.boolValue);
+            case TokenT::INT_LIT: return ConstantInt::get(getType(lexp->type), lexp->val.intValue);
+            case TokenT::DOUBLE_LIT: return ConstantFP::get(getType(lexp->type), lexp->val.doubleValue);
+            // Strings live in globals of their own.
+            default: return nullptr;
+        }
+    }
+    else if (instanceof<IdentifierExpr>(e)) {
+        auto &name = downcast<IdentifierExpr>(e)->ident.identName;
+        if (frame != nullptr) {
+            if (auto it = frame->vars.find(name); it != frame->vars.end()) return it->second.value;
+        }
+        else if (auto it = globals.find(name); it != globals.end()) return it->second;
+        if (auto it = addresses.find(name); it != addresses.end()) return it->second;
+        return nullptr;
+    }
+    else if (instanceof<GroupExpr>(e)) {
+        return evaluate(downcast<GroupExpr>(e)->expr, frame);
+    }
+    else if (instanceof<UnaryExpr>(e)) {
+        auto uexp = downcast<UnaryExpr>(e);
+        auto *operand = evaluate(uexp->expr, frame);
+        return operand != nullptr ? unary(uexp->op, operand) : nullptr;
+    }
+    else if (instanceof<BinaryExpr>(e)) {
+        auto bexp = downcast<BinaryExpr>(e);
+        auto *lhs = evaluate(bexp->left, frame);
+        if (lhs == nullptr) return nullptr;
+        // Short-circuits like the generated code, so the right operand needn't be constant.
+        if (lhs->getType()->isIntegerTy(1)) {
+            if (bexp->op == TokenT::AND && lhs->isZeroValue()) return lhs;
+            if (bexp->op == TokenT::OR && lhs->isOneValue()) return lhs;
+        }
+        auto *rhs = evaluate(bexp->right, frame);
+        return rhs != nullptr ? binary(bexp->op, bexp->type->isSigned(), lhs, rhs) : nullptr;
+    }
+    else if (instanceof<AssignExpr>(e)) {
+        auto aexp = downcast<AssignExpr>(e);
+        if (frame == nullptr || !instanceof<IdentifierExpr>(aexp->target)) return nullptr;
+        auto it = frame->vars.find(downcast<IdentifierExpr>(aexp->target)->ident.identName);
+        if (it == frame->vars.end()) return nullptr;
+        auto *value = evaluate(aexp->value, frame);
+        if (value == nullptr || value->getType() != it->second.type) return nullptr;
+        it->second.value = value;
+        return value;
+    }
+    else if (instanceof<CallExpr>(e)) {
+        auto cexp = downcast<CallExpr>(e);
+        auto *callee = dyn_cast_or_null<Function>(evaluate(cexp->callee, frame));
+        if (callee == nullptr) return nullptr;
+        std::vector<Constant*> args;
+        for (auto &arg : cexp->args) {
+            auto *value = evaluate(arg, frame);
+            if (value == nullptr) return nullptr;
+            args.push_back(value);
+        }
+        return evaluateCall(callee->getName().str(), args);
+    }
+    return nullptr;
+}
+
+Constant *ConstEvaluator::evaluateCall(const std::string &name, const std::vector<Constant*> &args) {
+    auto body = bodies.find(name);
+    if (body == bodies.end()) {
+        for (auto *key : active) waiting[name].push_back(*key);
+        return nullptr;
+    }
+    auto &decl = *body->second;
+    auto *rtype = getType(decl.type);
+    if (rtype->isVoidTy() || args.size() != decl.params.size() || depth >= maxDepth) return nullptr;
+
+    auto key = std::make_pair(name, args);
+    if (auto it = calls.find(key); it != calls.end()) return it->second;
+
+    Frame frame;
+    for (size_t i = 0; i < args.size(); i++) {
+        auto *type = getType(decl.params[i].type);
+        if (args[i]->getType() != type) return nullptr;
+        frame.vars.insert_or_assign(decl.params[i].name.identName, Var{type, args[i]});
+    }
+
+    depth++;
+    active.push_back(&key);
+    auto flow = execute(decl.body, frame);
+    active.pop_back();
+    depth--;
+
+    Constant *result = nullptr;
+    if (flow == Flow::Return && frame.result != nullptr && frame.result->getType() == rtype) result = frame.result;
+    // Running out of steps says nothing about the call itself; an initializer may still need it.
+    if (result != nullptr || steps <= limit) calls.insert({key, result});
+    return result;
+}
+
+ConstEvaluator::Flow ConstEvaluator::execute(const StmtSP &s, Frame &frame) {
+    if (++steps > limit) return Flow::Fail;
+
+    auto condition = [&](const ExprSP &e) -> int {
+        auto *value = dyn_cast_or_null<ConstantInt>(evaluate(e, &frame));
+        if (value == nullptr || !value->getType()->isIntegerTy(1)) return -1;
+        return value->isOne();
+    };
+
+    if (instanceof<BlockStmt>(s)) {
+        for (auto &i : downcast<BlockStmt>(s)->statements) {
+            auto flow = execute(i, frame);
+            if (flow != Flow::Next) return flow;
+        }
+        return Flow::Next;
+    }
+    else if (instanceof<ExprStmt>(s)) {
+        return evaluate(downcast<ExprStmt>(s)->expr, &frame) != nullptr ? Flow::Next : Flow::Fail;
+    }
+    else if (instanceof<VarDeclStmt>(s)) {
+        auto vards = downcast<VarDeclStmt>(s);
+        auto *type = getType(vards->type);
+        Constant *value = nullptr;
+        if (vards->value != nullptr) {
+            value = evaluate(vards->value, &frame);
+            if (value == nullptr || value->getType() != type) return Flow::Fail;
+        }
+        frame.vars.insert_or_assign(vards->name.identName, Var{type, value});
+        return Flow::Next;
+    }
+    else if (instanceof<ReturnStmt>(s)) {
+        auto rets = downcast<ReturnStmt>(s);
+        if (rets->value != nullptr) {
+            frame.result = evaluate(rets->value, &frame);
+            if (frame.result == nullptr) return Flow::Fail;
+        }
+        return Flow::Return;
+    }
+    else if (instanceof<IfStmt>(s)) {
+        auto ifs = downcast<IfStmt>(s);
+        auto taken = condition(ifs->condition);
+        if (taken < 0) return Flow::Fail;
+        if (taken) return execute(ifs->ifBody, frame);
+        return ifs->elseBody != nullptr ? execute(ifs->elseBody, frame) : Flow::Next;
+    }
+    else if (instanceof<WhileStmt>(s)) {
+        auto whs = downcast<WhileStmt>(s);
+        while (true) {
+            auto taken = condition(whs->condition);
+            if (taken < 0) return Flow::Fail;
+            if (!taken) break;
+            auto flow = execute(whs->body, frame);
+            if (flow == Flow::Break) break;
+            if (flow == Flow::Return || flow == Flow::Fail) return flow;
+        }
+        return Flow::Next;
+    }
+    else if (instanceof<ForStmt>(s)) {
+        auto fors = downcast<ForStmt>(s);
+        if (fors->init != nullptr && execute(fors->init, frame) != Flow::Next) return Flow::Fail;
+        while (true) {
+            auto taken = condition(fors->condition);
+            if (taken < 0) return Flow::Fail;
+            if (!taken) break;
+            auto flow = execute(fors->body, frame);
+            if (flow == Flow::Break) break;
+            // The generated code's continue skips the increment, so such loops are left to run time.
+            if (flow != Flow::Next) return flow == Flow::Return ? flow : Flow::Fail;
+            if (evaluate(fors->increment, &frame) == nullptr) return Flow::Fail;
+        }
+        return Flow::Next;
+    }
+    else if (instanceof<BreakStmt>(s)) return Flow::Break;
+    else if (instanceof<ContinueStmt>(s)) return Flow::Continue;
+    return Flow::Fail;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+
+#include "../parser/statement.hpp"
+#include "../util.hpp"
+
+namespace clpl {
+    // Evaluates expressions while compiling: literals, arithmetic, comparisons and calls of CLPL
+    // functions that only compute on their arguments and locals. Results are LLVM constants; null
+    // means the expression isn't constant, including when it would divide by zero or runs too long.
+    class ConstEvaluator {
+        private:
+            enum class Flow { Next, Break, Continue, Return, Fail };
+            struct Var {
+                llvm::Type *type;
+                // Null until a value is assigned.
+                llvm::Constant *value;
+            };
+            struct Frame {
+                std::unordered_map<std::string, Var> vars;
+                llvm::Constant *result = nullptr;
+            };
+
+            std::function<llvm::Type*(const TypeSP&)> getType;
+            std::unordered_map<std::string, FuncDeclStmtSP> bodies;
+            std::unordered_map<std::string, llvm::Function*> addresses;
+            // Initial values of globals, which only other global initializers may read: functions
+            // could run after the globals changed.
+            std::unordered_map<std::string, llvm::Constant*> globals;
+            typedef std::pair<std::string, std::vector<llvm::Constant*>> CallKey;
+            // Calls evaluated so far, null for those that aren't constant.
+            std::map<CallKey, llvm::Constant*> calls;
+            // Failed calls that reached a function without a body, to retry once it has one.
+            std::unordered_map<std::string, std::vector<CallKey>> waiting;
+            // Calls being evaluated, outermost first.
+            std::vector<const CallKey*> active;
+            // Steps of the current evaluation and its limit.
+            size_t steps = 0, limit = 0;
+            // Steps left for folding calls in the whole module.
+            size_t budget;
+            unsigned depth = 0;
+
+            llvm::Constant *evaluate(const ExprSP &e, Frame *frame);
+            llvm::Constant *evaluateCall(const std::string &name, const std::vector<llvm::Constant*> &args);
+            Flow execute(const StmtSP &s, Frame &frame);
+
+        public:
+            explicit ConstEvaluator(std::function<llvm::Type*(const TypeSP&)> getType);
+
+            // Makes a function callable from constant expressions; func's address is constant too.
+            void defineFunction(const FuncDeclStmtSP &decl, llvm::Function *func);
+            void defineGlobal(const std::string &name, llvm::Constant *value);
+
+            // Evaluates a global initializer, which may read earlier globals.
+            llvm::Constant *evaluate(const ExprSP &e);
+            // Result of calling a defined function with constant arguments. Unlike initializers,
+            // which must be constant, these optional folds share one step budget per module.
+            llvm::Constant *call(const std::string &name, const std::vector<llvm::Constant*> &args);
+
+            // The operators as the compiler generates them, on constant operands.
+            static llvm::Constant *unary(TokenT op, llvm::Constant *operand);
+            static llvm::Constant *binary(TokenT op, bool isSigned, llvm::Constant *lhs, llvm::Constant *rhs);
+            // Numeric conversion to type; null between incompatible types.
+            static llvm::Constant *convert(llvm::Constant *value, bool isSigned, llvm::Type *type);
+    };
+}
@@ -0,0 +1,132 @@
+#include "debuginfo.hpp"
+
+#include "llvm/BinaryFormat/Dwarf.h"
+#include "llvm/Support/FileSystem.h"
+
+using namespace llvm;
+using clpl::DebugInfo;
+
+static DICompileUnit::DebugEmissionKind emissionKind(clpl::DebugInfoKind kind) {
+    switch (kind) {
+        case clpl::DebugInfoKind::Full: return DICompileUnit::FullDebug;
+        case clpl::DebugInfoKind::LineTablesOnly: return DICompileUnit::LineTablesOnly;
+        default: return DICompileUnit::NoDebug;
+    }
+}
+
+DebugInfo::DebugInfo(Module &mod, StringRef sourceName, StringRef compilationDir, DebugInfoKind kind, bool optimized, bool forProfiling) : mod(mod), dbuilder(mod), kind(kind) {
+    // Like clang: the name is kept as given, relative ones resolve against the compilation directory.
+    SmallString<256> dir(compilationDir);
+    if (dir.empty()) sys::fs::current_path(dir);
+    file = dbuilder.createFile(sourceName, dir);
+
+    // There is no DWARF language code for CLPL; C is what debuggers evaluate expressions in best.
+    unit = dbuilder.createCompileUnit(dwarf::DW_LANG_C, file, "clplc", optimized, "", 0, "", emissionKind(kind), 0, true, forProfiling);
+
+    mod.addModuleFlag(Module::Warning, "Debug Info Version", DEBUG_METADATA_VERSION);
+    mod.addModuleFlag(Module::Max, "Dwarf Version", 5);
+}
+
+DIType *DebugInfo::getType(const TypeSP &type) {
+    auto name = type->toString();
+    if (auto it = types.find(name); it != types.end()) return it->second;
+
+    auto pointerBits = mod.getDataLayout().getPointerSizeInBits();
+    DIType *out = nullptr;
+    if (instanceof<NamedType>(type)) {
+        static const std::unordered_map<std::string, std::pair<uint64_t, unsigned>> basicTypes = {
+            {"bool", {8, dwarf::DW_ATE_boolean}},
+            {"i8", {8, dwarf::DW_ATE_signed}},
+            {"i16", {16, dwarf::DW_ATE_signed}},
+            {"i32", {32, dwarf::DW_ATE_signed}},
+            {"i64", {64, dwarf::DW_ATE_signed}},
+            {"u8", {8, dwarf::DW_ATE_unsigned_char}},
+            {"u16", {16, dwarf::DW_ATE_unsigned}},
+            {"u32", {32, dwarf::DW_ATE_unsigned}},
+            {"u64", {64, dwarf::DW_ATE_unsigned}},
+            {"f32", {32, dwarf::DW_ATE_float}},
+            {"f64", {64, dwarf::DW_ATE_float}},
+        };
+        if (name == "ptr") out = dbuilder.createPointerType(nullptr, pointerBits, 0, None, name);
+        else if (auto it = basicTypes.find(name); it != basicTypes.end()) {
+            out = dbuilder.createBasicType(name, it->second.first, it->second.second);
+        }
+        // void has no DWARF type.
+    }
+    else if (instanceof<PointerType>(type)) {
+        out = dbuilder.createPointerType(getType(downcast<PointerType>(type)->dataType), pointerBits);
+    }
+    else if (instanceof<FunctionReferenceType>(type)) {
+        auto ftype = downcast<FunctionReferenceType>(type);
+        out = dbuilder.createPointerType(getFunctionType(ftype->returnType, ftype->argTypes), pointerBits);
+    }
+
+    types.insert({name, out});
+    return out;
+}
+
+DISubroutineType *DebugInfo::getFunctionType(const TypeSP &returnType, const std::vector<TypeSP> &argTypes) {
+    std::vector<Metadata*> elements = {getType(returnType)};
+    for (auto &i : argTypes) elements.push_back(getType(i));
+    return dbuilder.createSubroutineType(dbuilder.getOrCreateTypeArray(elements));
+}
+
+void DebugInfo::beginFunction(Function *func, const FuncDeclStmt &decl) {
+    DISubroutineType *type;
+    if (kind == DebugInfoKind::Full) {
+        std::vector<TypeSP> argTypes;
+        for (auto &i : decl.params) argTypes.push_back(i.type);
+        type = getFunctionType(decl.type, argTypes);
+    }
+    else type = dbuilder.createSubroutineType(dbuilder.getOrCreateTypeArray({}));
+
+    auto flags = DISubprogram::SPFlagDefinition;
+    if (unit->isOptimized()) flags |= DISubprogram::SPFlagOptimized;
+    auto *subprogram = dbuilder.createFunction(file, decl.name.identName, "", file, decl.line, type, decl.body->line, DINode::FlagPrototyped, flags);
+    func->setSubprogram(subprogram);
+    scopes = {subprogram};
+}
+
+void DebugInfo::endFunction() {
+    dbuilder.finalizeSubprogram(cast<DISubprogram>(scopes.front()));
+    scopes.clear();
+}
+
+void DebugInfo::beginBlock(const Stmt &block) {
+    if (kind != DebugInfoKind::Full || scopes.empty()) return;
+    scopes.push_back(dbuilder.createLexicalBlock(scopes.back(), file, block.line, block.column));
+}
+
+void DebugInfo::endBlock() {
+    if (kind != DebugInfoKind::Full || scopes.size() < 2) return;
+    scopes.pop_back();
+}
+
+DILocation *DebugInfo::location(int line, int column) const {
+    if (scopes.empty()) return nullptr;
+    return DILocation::get(mod.getContext(), line, column, scopes.back());
+}
+
+void DebugInfo::declareParameter(AllocaInst *storage, unsigned argNo, const ParameterT &param, IRBuilder<> &builder) {
+    if (kind != DebugInfoKind::Full) return;
+    auto *var = dbuilder.createParameterVariable(scopes.front(), param.name.identName, argNo + 1, file, param.name.line, getType(param.type), true);
+    auto *loc = DILocation::get(mod.getContext(), param.name.line, param.name.column, scopes.front());
+    dbuilder.insertDeclare(storage, var, dbuilder.createExpression(), loc, builder.GetInsertBlock());
+}
+
+void DebugInfo::declareLocal(AllocaInst *storage, const VarDeclStmt &decl, IRBuilder<> &builder) {
+    if (kind != DebugInfoKind::Full) return;
+    auto *var = dbuilder.createAutoVariable(scopes.back(), decl.name.identName, file, decl.name.line, getType(decl.type), unit->isOptimized());
+    auto *loc = DILocation::get(mod.getContext(), decl.name.line, decl.name.column, scopes.back());
+    dbuilder.insertDeclare(storage, var, dbuilder.createExpression(), loc, builder.GetInsertBlock());
+}
+
+void DebugInfo::declareGlobal(GlobalVariable *var, const VarDeclStmt &decl) {
+    if (kind != DebugInfoKind::Full) return;
+    auto *expr = dbuilder.createGlobalVariableExpression(unit, decl.name.identName, "", file, decl.name.line, getType(decl.type), var->hasLocalLinkage());
+    var->addDebugInfo(expr);
+}
+
+void DebugInfo::finalize() {
+    dbuilder.finalize();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+
+#include "../parser/statement.hpp"
+#include "../util.hpp"
+
+namespace clpl {
+    enum class DebugInfoKind {
+        None,
+        // Only the source position of each instruction (-gline-tables-only).
+        LineTablesOnly,
+        // Positions plus types, parameters and local variables (-g).
+        Full
+    };
+
+    // Builds the DWARF metadata of one module. Locations are tracked even with DebugInfoKind::None
+    // when something else needs them (optimization remarks), but nothing is emitted into the object.
+    class DebugInfo {
+        private:
+            llvm::Module &mod;
+            llvm::DIBuilder dbuilder;
+            DebugInfoKind kind;
+            llvm::DIFile *file;
+            llvm::DICompileUnit *unit;
+            // Innermost last; empty outside of function bodies.
+            std::vector<llvm::DIScope*> scopes;
+            std::unordered_map<std::string, llvm::DIType*> types;
+
+            llvm::DIType *getType(const TypeSP &type);
+            llvm::DISubroutineType *getFunctionType(const TypeSP &returnType, const std::vector<TypeSP> &argTypes);
+
+        public:
+            // forProfiling marks the unit for -fdebug-info-for-profiling, which keeps more precise locations.
+            DebugInfo(llvm::Module &mod, llvm::StringRef sourceName, llvm::StringRef compilationDir, DebugInfoKind kind, bool optimized, bool forProfiling);
+
+            // Describes func and makes it the current scope until endFunction.
+            void beginFunction(llvm::Function *func, const FuncDeclStmt &decl);
+            void endFunction();
+            // Opens a lexical block, so that shadowing locals are told apart (-g only).
+            void beginBlock(const Stmt &block);
+            void endBlock();
+
+            // Location in the current scope; null outside of functions.
+            llvm::DILocation *location(int line, int column) const;
+
+            void declareParameter(llvm::AllocaInst *storage, unsigned argNo, const ParameterT &param, llvm::IRBuilder<> &builder);
+            void declareLocal(llvm::AllocaInst *storage, const VarDeclStmt &decl, llvm::IRBuilder<> &builder);
+            void declareGlobal(llvm::GlobalVariable *var, const VarDeclStmt &decl);
+
+            // Resolves forward references; call once code generation is done.
+            void finalize();
+    };
+}
@@ -0,0 +1,291 @@
+#include "incremental.hpp"
+#include "cacheutil.hpp"
+#include "compiler.hpp"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+using namespace llvm;
+using clpl::FunctionCache;
+
+// Bump whenever codegen changes in a way the function fingerprint doesn't capture.
+static constexpr const char *cacheVersion = "clplc-funccache-1";
+
+static void serialize(const clpl::TypeSP &type, std::string &out) {
+    out += type == nullptr ? "-" : type->toString();
+    out += ' ';
+}
+
+// Source positions only matter when they end up in the IR as debug locations.
+static void serialize(int line, int column, std::string &out) {
+    out += '@';
+    out += std::to_string(line);
+    out += ':';
+    out += std::to_string(column);
+    out += ' ';
+}
+
+static void serialize(const clpl::Token &tok, std::string &out, bool locations) {
+    out += tok.toString();
+    out += ' ';
+    if (locations) serialize(tok.line, tok.column, out);
+}
+
+static void serialize(const clpl::ExprSP &expr, std::string &out, bool locations) {
+    using namespace clpl;
+
+    if (expr == nullptr) {
+        out += "- ";
+        return;
+    }
+
+    out += '(';
+    if (locations) serialize(expr->line, expr->column, out);
+    serialize(expr->type, out);
+    if (instanceof<LiteralExpr>(expr)) {
+        out += "lit ";
+        serialize(downcast<LiteralExpr>(expr)->val, out, locations);
+    }
+    else if (instanceof<IdentifierExpr>(expr)) {
+        out += "ident ";
+        serialize(downcast<IdentifierExpr>(expr)->ident, out, locations);
+    }
+    else if (instanceof<UnaryExpr>(expr)) {
+        auto uexp = downcast<UnaryExpr>(expr);
+        out += "unary " + std::to_string((int) uexp->op) + " ";
+        serialize(uexp->expr, out, locations);
+    }
+    else if (instanceof<BinaryExpr>(expr)) {
+        auto bexp = downcast<BinaryExpr>(expr);
+        out += "binary " + std::to_string((int) bexp->op) + " ";
+        serialize(bexp->left, out, locations);
+        serialize(bexp->right, out, locations);
+    }
+    else if (instanceof<GroupExpr>(expr)) {
+        out += "group ";
+        serialize(downcast<GroupExpr>(expr)->expr, out, locations);
+    }
+    else if (instanceof<AssignExpr>(expr)) {
+        auto aexp = downcast<AssignExpr>(expr);
+        out += "assign ";
+        serialize(aexp->target, out, locations);
+        serialize(aexp->value, out, locations);
+    }
+    else if (instanceof<IndexExpr>(expr)) {
+        auto iexp = downcast<IndexExpr>(expr);
+        out += "index ";
+        serialize(iexp->target, out, locations);
+        serialize(iexp->index, out, locations);
+    }
+    else if (instanceof<ArrayLiteralExpr>(expr)) {
+        auto aexp = downcast<ArrayLiteralExpr>(expr);
+        out += aexp->writable ? "mutable-array " : "array ";
+        for (auto &element : aexp->elements) serialize(element, out, locations);
+    }
+    else if (instanceof<CallExpr>(expr)) {
+        auto cexp = downcast<CallExpr>(expr);
+        out += "call ";
+        serialize(cexp->callee, out, locations);
+        for (auto &arg : cexp->args) serialize(arg, out, locations);
+    }
+    else throw CompileError("Unsupported expression.");
+    out += ')';
+}
+
+static void serialize(const clpl::StmtSP &stmt, std::string &out, bool locations) {
+    using namespace clpl;
+
+    if (stmt == nullptr) {
+        out += "- ";
+        return;
+    }
+
+    out += '{';
+    if (locations) serialize(stmt->line, stmt->column, out);
+    if (instanceof<BlockStmt>(stmt)) {
+        out += "block ";
+        for (auto &i : downcast<BlockStmt>(stmt)->statements) serialize(i, out, locations);
+    }
+    else if (instanceof<ExprStmt>(stmt)) {
+        out += "expr ";
+        serialize(downcast<ExprStmt>(stmt)->expr, out, locations);
+    }
+    else if (instanceof<VarDeclStmt>(stmt)) {
+        auto vards = downcast<VarDeclStmt>(stmt);
+        out += "var ";
+        serialize(vards->type, out);
+        serialize(vards->name, out, locations);
+        serialize(vards->value, out, locations);
+    }
+    else if (instanceof<ReturnStmt>(stmt)) {
+        out += "return ";
+        serialize(downcast<ReturnStmt>(stmt)->value, out, locations);
+    }
+    else if (instanceof<IfStmt>(stmt)) {
+        auto ifs = downcast<IfStmt>(stmt);
+        out += "if ";
+        serialize(ifs->condition, out, locations);
+        serialize(ifs->ifBody, out, locations);
+        serialize(ifs->elseBody, out, locations);
+    }
+    else if (instanceof<WhileStmt>(stmt)) {
+        auto whs = downcast<WhileStmt>(stmt);
+        out += "while ";
+        serialize(whs->condition, out, locations);
+        serialize(whs->body, out, locations);
+    }
+    else if (instanceof<ForStmt>(stmt)) {
+        auto fors = downcast<ForStmt>(stmt);
+        out += "for ";
+        serialize(fors->init, out, locations);
+        serialize(fors->condition, out, locations);
+        serialize(fors->increment, out, locations);
+        serialize(fors->body, out, locations);
+    }
+    else if (instanceof<BreakStmt>(stmt)) out += "break ";
+    else if (instanceof<ContinueStmt>(stmt)) out += "continue ";
+    else throw CompileError("Unsupported statement.");
+    out += '}';
+}
+
+FunctionCache::FunctionCache(std::string dir) : dir(std::move(dir)) {
+    sys::fs::create_directories(this->dir);
+}
+
+std::string FunctionCache::fingerprint(const FuncDeclStmt &func, StringRef sourceName, const CompileOptions &options) {
+    bool locations = options.tracksLocations();
+    std::string ast;
+    serialize(func.type, ast);
+    serialize(func.name, ast, locations);
+    for (auto &i : func.params) {
+        serialize(i.type, ast);
+        serialize(i.name, ast, locations);
+        ast += std::to_string(i.restrict) + std::to_string(i.nocapture) + std::to_string(i.readonly) + ' ';
+    }
+    serialize(func.body, ast, locations);
+    if (locations) serialize(func.line, func.column, ast);
+
+    return CacheKey(cacheVersion)
+        .add("generic")
+        .add(std::to_string(options.optLevel))
+        .add(std::to_string((int) options.debugInfo))
+        .add(options.debugInfoForProfiling ? "discriminators" : "")
+        .add(std::to_string((int) options.instrument))
+        .add(options.emitsTBAA() ? "tbaa" : "")
+        .add(locations ? sourceName : "")
+        .add(ast)
+        .str();
+}
+
+std::unique_ptr<Module> FunctionCache::load(const std::string &key, LLVMContext &context) const {
+    SmallString<256> path(dir);
+    sys::path::append(path, key + ".bc");
+    if (!touchCacheEntry(std::string(path))) return nullptr;
+
+    auto buf = MemoryBuffer::getFile(path);
+    if (!buf) return nullptr;
+
+    auto mod = parseBitcodeFile((*buf)->getMemBufferRef(), context);
+    if (!mod) {
+        consumeError(mod.takeError());
+        return nullptr;
+    }
+    return std::move(*mod);
+}
+
+static void collectGlobals(const Value *val, SmallPtrSetImpl<const GlobalValue*> &out) {
+    if (auto *gv = dyn_cast<GlobalValue>(val)) {
+        out.insert(gv);
+        return;
+    }
+    if (auto *c = dyn_cast<Constant>(val)) {
+        for (auto &op : c->operands()) collectGlobals(op, out);
+    }
+}
+
+// Globals nobody else can refer to (string literals, array tables) travel with the function.
+static bool travelsWithFunction(const GlobalValue *gv) {
+    return isa<GlobalVariable>(gv) && (gv->hasPrivateLinkage() || !gv->hasName());
+}
+
+void FunctionCache::store(const std::string &key, const Function &func) const {
+    SmallPtrSet<const GlobalValue*, 16> used;
+    for (auto &inst : instructions(func)) {
+        for (auto &op : inst.operands()) collectGlobals(op, used);
+    }
+    SmallVector<const GlobalValue*, 16> worklist(used.begin(), used.end());
+    while (!worklist.empty()) {
+        auto *gvar = dyn_cast<GlobalVariable>(worklist.pop_back_val());
+        if (gvar == nullptr || !travelsWithFunction(gvar) || !gvar->hasInitializer()) continue;
+        SmallPtrSet<const GlobalValue*, 4> refs;
+        collectGlobals(gvar->getInitializer(), refs);
+        for (auto *ref : refs) {
+            if (used.insert(ref).second) worklist.push_back(ref);
+        }
+    }
+
+    // Build the entry from scratch rather than cloning the whole module, everything the function
+    // refers to becomes a declaration, including the program's internal variables.
+    const Module &src = *func.getParent();
+    auto entry = std::make_unique<Module>(src.getModuleIdentifier(), func.getContext());
+    entry->setSourceFileName(src.getSourceFileName());
+    entry->setDataLayout(src.getDataLayout());
+    entry->setTargetTriple(src.getTargetTriple());
+    SmallVector<Module::ModuleFlagEntry, 4> flags;
+    src.getModuleFlagsMetadata(flags);
+    for (auto &flag : flags) entry->addModuleFlag(flag.Behavior, flag.Key->getString(), flag.Val);
+
+    ValueToValueMapTy vmap;
+    SmallVector<std::pair<GlobalVariable*, const GlobalVariable*>, 4> definitions;
+    for (auto *gv : used) {
+        if (gv == &func) continue;
+        if (auto *f = dyn_cast<Function>(gv)) {
+            auto *decl = Function::Create(f->getFunctionType(), GlobalValue::ExternalLinkage, f->getAddressSpace(), f->getName(), entry.get());
+            decl->copyAttributesFrom(f);
+            vmap[f] = decl;
+        }
+        else if (auto *gvar = dyn_cast<GlobalVariable>(gv)) {
+            bool travels = travelsWithFunction(gvar);
+            auto *copy = new GlobalVariable(*entry, gvar->getValueType(), gvar->isConstant(),
+                travels ? gvar->getLinkage() : GlobalValue::ExternalLinkage, nullptr, gvar->getName(), nullptr,
+                gvar->getThreadLocalMode(), gvar->getAddressSpace());
+            copy->copyAttributesFrom(gvar);
+            if (travels && gvar->hasInitializer()) definitions.push_back({ copy, gvar });
+            vmap[gvar] = copy;
+        }
+        // The compiler never emits aliases, leave such a function uncached.
+        else return;
+    }
+    for (auto &[copy, gvar] : definitions) copy->setInitializer(MapValue(gvar->getInitializer(), vmap));
+
+    auto *clone = Function::Create(func.getFunctionType(), func.getLinkage(), func.getAddressSpace(), func.getName(), entry.get());
+    vmap[&func] = clone;
+    auto arg = clone->arg_begin();
+    for (auto &i : func.args()) {
+        arg->setName(i.getName());
+        vmap[&i] = &*arg++;
+    }
+    SmallVector<ReturnInst*, 8> returns;
+    CloneFunctionInto(clone, &func, vmap, CloneFunctionChangeType::DifferentModule, returns);
+    // Cloning always creates the compile unit list, an empty one makes the reader strip "invalid" debug info.
+    if (auto *units = entry->getNamedMetadata("llvm.dbg.cu"); units != nullptr && units->getNumOperands() == 0) {
+        entry->eraseNamedMetadata(units);
+    }
+
+    publishCacheEntry(dir, key + ".bc", [&](int fd) {
+        raw_fd_ostream os(fd, false);
+        WriteBitcodeToFile(*entry, os);
+        os.flush();
+        return os.error();
+    });
+}
+
+void FunctionCache::prune(uint64_t maxSize) const {
+    pruneCacheDir(dir, ".bc", maxSize);
+}
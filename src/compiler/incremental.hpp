@@ -0,0 +1,33 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+
+#include "../parser/statement.hpp"
+
+namespace clpl {
+    struct CompileOptions;
+
+    // Per-function cache of optimized IR. Entries are keyed by a fingerprint of the function's AST,
+    // which includes the name and type of every identifier it references and so the signatures it
+    // depends on, and with debug locations in the IR also source positions and the file name.
+    // Functions are only optimized in isolation while it is active, so an entry never embeds code
+    // from another function.
+    class FunctionCache {
+        private:
+            std::string dir;
+
+        public:
+            explicit FunctionCache(std::string dir);
+
+            static std::string fingerprint(const FuncDeclStmt &func, llvm::StringRef sourceName, const CompileOptions &options);
+
+            // Returns a module holding the cached definition, or nullptr on a miss.
+            std::unique_ptr<llvm::Module> load(const std::string &key, llvm::LLVMContext &context) const;
+            void store(const std::string &key, const llvm::Function &func) const;
+            void prune(uint64_t maxSize) const;
+    };
+}
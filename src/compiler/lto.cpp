@@ -0,0 +1,96 @@
+#include "lto.hpp"
+#include "target.hpp"
+
+#include "llvm/LTO/LTO.h"
+#include "llvm/Object/ArchiveWriter.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Threading.h"
+
+#include <map>
+#include <set>
+
+using namespace llvm;
+
+// Name of partition N inside the archive, "<stem>.<N>.o".
+static std::string partitionName(const std::string &outpath, unsigned task) {
+    return sys::path::stem(outpath).str() + "." + std::to_string(task) + ".o";
+}
+
+void clpl::ltoLink(const std::vector<std::string> &inputs, const std::string &outpath, const CompileOptions &options, unsigned jobs) {
+    initializeNativeTarget();
+
+    lto::Config conf;
+    conf.CPU = "generic";
+    conf.RelocModel = Optional<Reloc::Model>();
+    conf.OptLevel = options.optLevel;
+    conf.CGOptLevel = conf.OptLevel == 0 ? CodeGenOpt::None : conf.OptLevel == 3 ? CodeGenOpt::Aggressive : CodeGenOpt::Default;
+    conf.RemarksFilename = options.optRecordFile;
+    conf.RemarksFormat = options.optRecordFormat;
+    // ThinLTO backends annotate the imported functions again after the prelink did.
+    conf.SampleProfile = options.profileSampleUse;
+
+    auto parallelism = heavyweight_hardware_concurrency(jobs);
+    lto::LTO lto(std::move(conf), lto::createInProcessThinBackend(parallelism), parallelism.compute_thread_count());
+
+    std::vector<std::unique_ptr<MemoryBuffer>> buffers;
+    std::set<std::string> defined;
+    std::map<std::string, std::string> strongDefinitions;
+    for (auto &in : inputs) {
+        auto buf = MemoryBuffer::getFile(in);
+        if (!buf) throw LinkError(in + ": " + buf.getError().message());
+
+        auto file = lto::InputFile::create((*buf)->getMemBufferRef());
+        if (!file) throw LinkError(in + ": " + toString(file.takeError()));
+
+        std::vector<lto::SymbolResolution> res;
+        for (auto &sym : (*file)->symbols()) {
+            lto::SymbolResolution r;
+            bool isDefinition = !sym.isUndefined();
+            // A native link would reject the second definition rather than pick one.
+            if (isDefinition && !sym.isWeak() && !sym.isCommon()) {
+                auto [prev, inserted] = strongDefinitions.insert({sym.getName().str(), in});
+                if (!inserted) throw LinkError("duplicate symbol '" + sym.getName().str() + "' in " + prev->second + " and " + in);
+            }
+            r.Prevailing = isDefinition && defined.insert(sym.getName().str()).second;
+            r.FinalDefinitionInLinkageUnit = isDefinition;
+            // The result is linked against regular objects we know nothing about.
+            r.VisibleToRegularObj = true;
+            res.push_back(r);
+        }
+
+        if (auto err = lto.add(std::move(*file), res)) throw LinkError(in + ": " + toString(std::move(err)));
+        buffers.push_back(std::move(*buf));
+    }
+
+    // Backends run concurrently, each into its own buffer; nothing is written until all succeeded.
+    std::vector<SmallString<0>> objects(lto.getMaxTasks());
+    auto addStream = [&](unsigned task) -> Expected<std::unique_ptr<CachedFileStream>> {
+        return std::make_unique<CachedFileStream>(std::make_unique<raw_svector_ostream>(objects[task]));
+    };
+
+    if (auto err = lto.run(addStream)) throw LinkError(toString(std::move(err)));
+
+    std::vector<NewArchiveMember> members;
+    for (unsigned task = 0; task < objects.size(); task++) {
+        if (objects[task].empty()) continue;
+        NewArchiveMember member(MemoryBufferRef(objects[task].str(), partitionName(outpath, task)));
+        members.push_back(std::move(member));
+    }
+    if (members.empty()) throw LinkError("no object code was produced.");
+
+    if (members.size() == 1) {
+        std::error_code EC;
+        raw_fd_ostream os(outpath, EC, sys::fs::OF_None);
+        if (EC) throw LinkError(outpath + ": " + EC.message());
+        os << members[0].Buf->getBuffer();
+        os.close();
+        if (os.has_error()) throw LinkError(outpath + ": " + os.error().message());
+        return;
+    }
+
+    if (auto err = writeArchive(outpath, members, true, object::Archive::K_GNU, true, false)) {
+        throw LinkError(outpath + ": " + toString(std::move(err)));
+    }
+}
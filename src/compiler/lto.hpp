@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "compiler.hpp"
+
+namespace clpl {
+    struct LinkError : public std::exception {
+        std::string msg;
+        explicit LinkError(std::string msg) : msg(std::move(msg)) { }
+    };
+
+    // Links bitcode files produced with -flto=thin/full and writes the optimized code to outpath.
+    // A single partition is written as a plain object, several as an archive whose members are named
+    // "<stem>.<N>.o". ThinLTO makes one partition per input, and with more than one job full LTO splits
+    // its code generation into one per thread. Throws LinkError on duplicate strong definitions.
+    void ltoLink(const std::vector<std::string> &inputs, const std::string &outpath, const CompileOptions &options, unsigned jobs = 0);
+}
@@ -0,0 +1,99 @@
+#include "memreport.hpp"
+
+#include "llvm/Demangle/Demangle.h"
+#include "llvm/Support/Format.h"
+
+#include <sys/resource.h>
+
+using namespace llvm;
+
+static long processPeakRSS() {
+    rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+}
+
+clpl::MemoryReport::MemoryReport() : lastPeakRSS(processPeakRSS()) { }
+
+void clpl::MemoryReport::allocated(const std::type_info &node, size_t bytes) {
+    std::lock_guard lock(mutex);
+    // Keyed by the mangled type name, demangled when printing.
+    auto &entry = nodes[node.name()];
+    entry.count++;
+    entry.bytes += bytes;
+}
+
+void clpl::MemoryReport::phaseFinished(Phase phase) {
+    auto peak = processPeakRSS();
+    if (peak == 0) return;
+
+    std::lock_guard lock(mutex);
+    peakRSS[(int) phase] = std::max(peakRSS[(int) phase], peak);
+    peakGrowth[(int) phase] += std::max(0l, peak - lastPeakRSS);
+    lastPeakRSS = std::max(lastPeakRSS, peak);
+}
+
+void clpl::MemoryReport::recordParser(const ParserStats &stats) {
+    std::lock_guard lock(mutex);
+    parser = stats;
+    symbolTables.push_back({"parser types", stats.types});
+    symbolTables.push_back({"parser functions", stats.functions});
+    symbolTables.push_back({"parser globals", stats.globals});
+}
+
+void clpl::MemoryReport::recordSymbolTable(StringRef name, size_t size) {
+    std::lock_guard lock(mutex);
+    symbolTables.push_back({name.str(), size});
+}
+
+void clpl::MemoryReport::recordModule(StringRef when, const Module &mod) {
+    ModuleCounts counts;
+    counts.when = when.str();
+    counts.globals = mod.global_size();
+    for (auto &func : mod) {
+        if (func.isDeclaration()) {
+            counts.declarations++;
+            continue;
+        }
+        counts.functions++;
+        counts.blocks += func.size();
+        counts.instructions += func.getInstructionCount();
+    }
+
+    std::lock_guard lock(mutex);
+    modules.push_back(counts);
+}
+
+void clpl::MemoryReport::print(raw_ostream &os) {
+    std::lock_guard lock(mutex);
+    os << "===-------------------------------------------------------------------------===\n"
+       << "                              Memory usage report\n"
+       << "===-------------------------------------------------------------------------===\n";
+
+    os << "Process peak RSS after each phase, and how much the phase raised it:\n";
+    for (int i = 0; i < (int) Phase::Count; i++) {
+        if (peakRSS[i] == 0) continue;
+        os << "  " << left_justify(phaseName((Phase) i), 24) << format("%10ld KiB  +%ld KiB\n", peakRSS[i], peakGrowth[i]);
+    }
+
+    os << "Tokens: " << parser.tokens << " (" << parser.tokenBytes << " bytes)\n";
+
+    os << "AST allocations:\n";
+    size_t totalCount = 0, totalBytes = 0;
+    for (auto &[name, entry] : nodes) {
+        os << "  " << left_justify(demangle("_Z" + name), 32) << format("%10zu %12zu bytes\n", entry.count, entry.bytes);
+        totalCount += entry.count;
+        totalBytes += entry.bytes;
+    }
+    os << "  " << left_justify("Total", 32) << format("%10zu %12zu bytes\n", totalCount, totalBytes);
+
+    os << "Symbol tables:\n";
+    for (auto &[name, size] : symbolTables) {
+        os << "  " << left_justify(name, 32) << format("%10zu\n", size);
+    }
+
+    for (auto &m : modules) {
+        os << "LLVM module " << m.when << ": " << m.functions << " functions, " << m.declarations
+           << " declarations, " << m.globals << " globals, " << m.blocks << " blocks, "
+           << m.instructions << " instructions\n";
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "../parser/parser.hpp"
+#include "timing.hpp"
+
+namespace clpl {
+    // Collects what -fmem-report prints for one compile. Safe to feed from the parser and
+    // code generation threads of a pipelined compile at the same time.
+    class MemoryReport : public AllocationHook {
+        private:
+            struct Allocations {
+                size_t count = 0;
+                size_t bytes = 0;
+            };
+
+            struct ModuleCounts {
+                std::string when;
+                size_t functions = 0, declarations = 0, globals = 0, blocks = 0, instructions = 0;
+            };
+
+            std::mutex mutex;
+            std::map<std::string, Allocations> nodes;
+            // The process peak resident set size in KiB as each phase ends, and how far the phase
+            // raised it. Other work in the same process (a server, -j) is included.
+            long peakRSS[(int) Phase::Count] = {};
+            long peakGrowth[(int) Phase::Count] = {};
+            long lastPeakRSS = 0;
+            ParserStats parser;
+            std::vector<std::pair<std::string, size_t>> symbolTables;
+            std::vector<ModuleCounts> modules;
+
+        public:
+            MemoryReport();
+
+            void allocated(const std::type_info &node, size_t bytes) override;
+            void phaseFinished(Phase phase);
+            void recordParser(const ParserStats &stats);
+            void recordSymbolTable(llvm::StringRef name, size_t size);
+            void recordModule(llvm::StringRef when, const llvm::Module &mod);
+            void print(llvm::raw_ostream &os);
+    };
+}
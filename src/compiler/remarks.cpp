@@ -0,0 +1,79 @@
+#include "remarks.hpp"
+#include "compiler.hpp"
+
+#include "llvm/IR/DiagnosticPrinter.h"
+
+using namespace llvm;
+
+static std::optional<Regex> compilePattern(const std::string &pattern, const char *flag) {
+    if (pattern.empty()) return std::nullopt;
+
+    Regex regex(pattern);
+    std::string error;
+    if (!regex.isValid(error)) throw clpl::CompileError(std::string("Invalid ") + flag + " pattern '" + pattern + "': " + error + ".");
+    return regex;
+}
+
+clpl::RemarkHandler::RemarkHandler(const CompileOptions &options, std::string sourceName, const std::unordered_map<std::string, int> &functionLines)
+    : passed(compilePattern(options.remarksPassed, "-Rpass")),
+      missed(compilePattern(options.remarksMissed, "-Rpass-missed")),
+      analysis(compilePattern(options.remarksAnalysis, "-Rpass-analysis")),
+      sourceName(std::move(sourceName)), functionLines(functionLines), os(text) { }
+
+bool clpl::RemarkHandler::handleDiagnostics(const DiagnosticInfo &DI) {
+    auto *remark = dyn_cast<DiagnosticInfoOptimizationBase>(&DI);
+    if (remark == nullptr) {
+        std::string text;
+        raw_string_ostream textStream(text);
+        DiagnosticPrinterRawOStream printer(textStream);
+        DI.print(printer);
+        messages.push_back({DI.getSeverity(), textStream.str()});
+        return true;
+    }
+    if (!remark->isEnabled()) return true;
+
+    const char *flag;
+    switch (DI.getKind()) {
+        case DK_OptimizationRemark:
+        case DK_MachineOptimizationRemark:
+            flag = "-Rpass";
+            break;
+        case DK_OptimizationRemarkMissed:
+        case DK_MachineOptimizationRemarkMissed:
+            flag = "-Rpass-missed";
+            break;
+        default:
+            flag = "-Rpass-analysis";
+            break;
+    }
+
+    if (remark->isLocationAvailable()) {
+        StringRef file;
+        unsigned line, column;
+        remark->getLocation(file, line, column);
+        os << file << ":" << line << ":" << column;
+    }
+    else {
+        os << sourceName;
+        auto it = functionLines.find(remark->getFunction().getName().str());
+        if (it != functionLines.end()) os << ":" << it->second;
+    }
+    os << ": remark: " << remark->getMsg() << " [" << flag << "=" << remark->getPassName() << "]\n";
+    return true;
+}
+
+bool clpl::RemarkHandler::isAnalysisRemarkEnabled(StringRef passName) const {
+    return analysis && analysis->match(passName);
+}
+
+bool clpl::RemarkHandler::isMissedOptRemarkEnabled(StringRef passName) const {
+    return missed && missed->match(passName);
+}
+
+bool clpl::RemarkHandler::isPassedOptRemarkEnabled(StringRef passName) const {
+    return passed && passed->match(passName);
+}
+
+bool clpl::RemarkHandler::isAnyRemarkEnabled() const {
+    return passed || missed || analysis;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace clpl {
+    struct CompileOptions;
+
+    // Formats the optimization remarks picked by -Rpass, -Rpass-missed and -Rpass-analysis like
+    // clang does. A remark without a debug location is reported at the line of its function.
+    // Every other LLVM diagnostic is kept too, so that LLVM never prints one or exits on an error.
+    class RemarkHandler : public llvm::DiagnosticHandler {
+        public:
+            struct Message {
+                llvm::DiagnosticSeverity severity;
+                std::string text;
+            };
+
+        private:
+            std::optional<llvm::Regex> passed, missed, analysis;
+            std::string sourceName;
+            const std::unordered_map<std::string, int> &functionLines;
+            std::string text;
+            llvm::raw_string_ostream os;
+            std::vector<Message> messages;
+
+        public:
+            // Throws CompileError on an invalid pattern.
+            RemarkHandler(const CompileOptions &options, std::string sourceName, const std::unordered_map<std::string, int> &functionLines);
+
+            const std::string &remarks() { return os.str(); }
+            const std::vector<Message> &diagnostics() const { return messages; }
+
+            bool handleDiagnostics(const llvm::DiagnosticInfo &DI) override;
+            bool isAnalysisRemarkEnabled(llvm::StringRef passName) const override;
+            bool isMissedOptRemarkEnabled(llvm::StringRef passName) const override;
+            bool isPassedOptRemarkEnabled(llvm::StringRef passName) const override;
+            bool isAnyRemarkEnabled() const override;
+    };
+}
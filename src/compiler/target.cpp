@@ -0,0 +1,47 @@
+#include "target.hpp"
+#include "compiler.hpp"
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include <mutex>
+
+using namespace llvm;
+
+static std::once_flag targetInitFlag;
+static const Target *nativeTarget = nullptr;
+static std::string nativeTriple;
+// Why nativeTarget is null, reported when a target machine is first needed.
+static std::string nativeTargetError;
+
+void clpl::initializeNativeTarget() {
+    std::call_once(targetInitFlag, [] {
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+        InitializeNativeTargetAsmParser();
+
+        nativeTriple = sys::getDefaultTargetTriple();
+        nativeTarget = TargetRegistry::lookupTarget(nativeTriple, nativeTargetError);
+    });
+}
+
+std::unique_ptr<TargetMachine> clpl::createNativeTargetMachine() {
+    initializeNativeTarget();
+    if (nativeTarget == nullptr) throw CompileError("Unable to find the native target '" + nativeTriple + "': " + nativeTargetError);
+
+    llvm::TargetOptions opts;
+    auto CPU = "generic";
+    auto features = "";
+
+    auto RM = Optional<Reloc::Model>();
+    std::unique_ptr<TargetMachine> targetMachine(nativeTarget->createTargetMachine(nativeTriple, CPU, features, opts, RM));
+    if (targetMachine == nullptr) throw CompileError("Unable to create a target machine for '" + nativeTriple + "'.");
+    return targetMachine;
+}
+
+TargetMachine *clpl::getNativeTargetMachine() {
+    thread_local std::unique_ptr<TargetMachine> targetMachine = createNativeTargetMachine();
+    return targetMachine.get();
+}
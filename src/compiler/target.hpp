@@ -0,0 +1,17 @@
+#pragma once
+
+#include <memory>
+
+#include <llvm/Target/TargetMachine.h>
+
+namespace clpl {
+    // Registers the native target once per process; safe to call from any thread.
+    void initializeNativeTarget();
+
+    // Throws CompileError when the native target is not available.
+    std::unique_ptr<llvm::TargetMachine> createNativeTargetMachine();
+
+    // A TargetMachine owned by the calling thread, created on first use and kept for the thread's
+    // lifetime so that workers of a long running process don't rebuild it for every compile.
+    llvm::TargetMachine *getNativeTargetMachine();
+}
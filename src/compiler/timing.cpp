@@ -0,0 +1,34 @@
+#include "timing.hpp"
+#include "memreport.hpp"
+
+using namespace llvm;
+
+static const char *phaseNames[] = {
+    "Scanning",
+    "Parsing",
+    "IR generation",
+    "Optimization",
+    "Code generation"
+};
+
+const char *clpl::phaseName(Phase phase) {
+    return phaseNames[(int) phase];
+}
+
+clpl::PhaseTimers::PhaseTimers() : group("clplc", "Compiler phases"), passOS(passReport) {
+    for (int i = 0; i < (int) Phase::Count; i++) {
+        timers[i].init(phaseNames[i], phaseNames[i], group);
+    }
+}
+
+void clpl::PhaseTimers::print(raw_ostream &os) {
+    group.print(os, true);
+    os << passOS.str();
+}
+
+clpl::PhaseScope::PhaseScope(PhaseTimers *timers, Phase phase, MemoryReport *memory)
+    : region(timers != nullptr ? &timers->get(phase) : nullptr), trace(phaseNames[(int) phase]), memory(memory), phase(phase) { }
+
+clpl::PhaseScope::~PhaseScope() {
+    if (memory != nullptr) memory->phaseFinished(phase);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+
+#include <llvm/Support/Timer.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace clpl {
+    enum class Phase {
+        Scanning,
+        Parsing,
+        IRGeneration,
+        Optimization,
+        CodeGeneration,
+        Count
+    };
+
+    const char *phaseName(Phase phase);
+
+    class MemoryReport;
+
+    // Wall and CPU time of each phase of one compile for -ftime-report, plus the new pass
+    // manager's per-pass timings, which are collected as text in passStream().
+    class PhaseTimers {
+        private:
+            llvm::TimerGroup group;
+            llvm::Timer timers[(int) Phase::Count];
+            std::string passReport;
+            llvm::raw_string_ostream passOS;
+
+        public:
+            PhaseTimers();
+            llvm::Timer &get(Phase phase) { return timers[(int) phase]; }
+            llvm::raw_ostream &passStream() { return passOS; }
+            void print(llvm::raw_ostream &os);
+    };
+
+    // Times a phase when timers is set and opens a -ftime-trace span when the calling thread has
+    // the time trace profiler enabled. With a memory report, peak RSS is sampled when the phase ends.
+    class PhaseScope {
+        private:
+            llvm::TimeRegion region;
+            llvm::TimeTraceScope trace;
+            MemoryReport *memory;
+            Phase phase;
+
+        public:
+            PhaseScope(PhaseTimers *timers, Phase phase, MemoryReport *memory = nullptr);
+            ~PhaseScope();
+    };
+}
@@ -0,0 +1,100 @@
+#include "cache.hpp"
+#include "cacheutil.hpp"
+
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+using namespace llvm;
+using clpl::ObjectCache;
+
+// Bump whenever the emitted code changes in a way the inputs to computeKey don't capture.
+static constexpr const char *cacheVersion = "clplc-objcache-1";
+
+ObjectCache::ObjectCache(std::string dir, uint64_t maxSize, bool hardlink) : dir(std::move(dir)), maxSize(maxSize), hardlink(hardlink) {
+    sys::fs::create_directories(this->dir);
+}
+
+std::string ObjectCache::entryPath(const std::string &key) const {
+    SmallString<256> path(dir);
+    sys::path::append(path, key + ".o");
+    return std::string(path);
+}
+
+// Size and modification time stand in for the contents of a file the output depends on.
+static std::string fileStamp(const std::string &path) {
+    sys::fs::file_status status;
+    if (path.empty() || sys::fs::status(path, status)) return "";
+    return std::to_string(status.getSize()) + ":" + std::to_string(sys::toTimeT(status.getLastModificationTime()));
+}
+
+std::string ObjectCache::computeKey(const std::string &source, const std::string &sourceName, const CompileOptions &options) {
+    // Relative names are recorded along with the compilation directory.
+    SmallString<256> compDir;
+    if (options.debugInfo != DebugInfoKind::None) {
+        compDir = options.compilationDir;
+        if (compDir.empty()) sys::fs::current_path(compDir);
+    }
+
+    return CacheKey(cacheVersion)
+        .add("generic")
+        .add(std::to_string(options.optLevel))
+        .add(std::to_string((int) options.lto))
+        .add(options.incrementalDir.empty() ? "whole-module" : "incremental")
+        .add(options.pipeline ? "pipeline" : "batch")
+        .add(std::to_string((int) options.debugInfo))
+        .add(sourceName)
+        .add(compDir)
+        .add(options.profileGenerate)
+        .add(options.profileUse)
+        .add(fileStamp(options.profileUse))
+        .add(options.profileSampleUse)
+        .add(fileStamp(options.profileSampleUse))
+        .add(options.debugInfoForProfiling ? "discriminators" : "")
+        .add(std::to_string((int) options.instrument))
+        .add(options.emitsTBAA() ? "tbaa" : "")
+        .add(source)
+        .str();
+}
+
+// Copies from to a new file at to, sharing its extents (FICLONE) when the file system allows.
+static bool cloneFile(const std::string &from, const std::string &to) {
+    int in, out;
+    if (sys::fs::openFileForRead(from, in)) return false;
+    if (sys::fs::openFileForWrite(to, out)) {
+        sys::fs::closeFile(in);
+        return false;
+    }
+
+    bool ok = false;
+#ifdef FICLONE
+    ok = ioctl(out, FICLONE, in) == 0;
+#endif
+    if (!ok) ok = !sys::fs::copy_file(from, out);
+    sys::fs::closeFile(in);
+    sys::fs::closeFile(out);
+    if (!ok) sys::fs::remove(to);
+    return ok;
+}
+
+bool ObjectCache::fetch(const std::string &key, const std::string &outpath) const {
+    auto entry = entryPath(key);
+    if (!touchCacheEntry(entry)) return false;
+
+    sys::fs::remove(outpath);
+    if (hardlink && !sys::fs::create_hard_link(entry, outpath)) return true;
+    return cloneFile(entry, outpath);
+}
+
+void ObjectCache::store(const std::string &key, const std::string &outpath) const {
+    publishCacheEntry(dir, key + ".o", [&](int fd) { return sys::fs::copy_file(outpath, fd); });
+}
+
+void ObjectCache::prune() const {
+    pruneCacheDir(dir, ".o", maxSize);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "compiler.hpp"
+
+namespace clpl {
+    // On-disk cache of compiled objects keyed by a hash of everything that affects the output.
+    // Entries are published with an atomic rename, so several clplc processes may share a directory.
+    class ObjectCache {
+        private:
+            std::string dir;
+            uint64_t maxSize;
+            bool hardlink;
+
+            std::string entryPath(const std::string &key) const;
+
+        public:
+            // With hardlink, hits share the entry's inode, so editing an output in place corrupts the
+            // cache and using the entry again bumps the output's modification time.
+            ObjectCache(std::string dir, uint64_t maxSize, bool hardlink = false);
+
+            // sourceName is part of every key: objects name their source file (STT_FILE, and the
+            // bitcode source_filename, which seeds the GUIDs of internal symbols under -flto).
+            static std::string computeKey(const std::string &source, const std::string &sourceName, const CompileOptions &options);
+
+            // Materializes the entry for key at outpath as a reflink where the file system supports it,
+            // a copy otherwise, or a hardlink if requested.
+            // Returns false on a miss.
+            bool fetch(const std::string &key, const std::string &outpath) const;
+            void store(const std::string &key, const std::string &outpath) const;
+
+            // Evicts least recently used entries until the directory fits in maxSize bytes.
+            void prune() const;
+    };
+}
@@ -0,0 +1,487 @@
+#include "driver.hpp"
+
+#include "api.hpp"
+#include "parser.hpp"
+#include "lto.hpp"
+#include "server.hpp"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace llvm;
+
+struct DriverArgs {
+    clpl::CompileOptions options;
+    unsigned jobs = 0;
+    bool compileOnly = false;
+    std::string output;
+    std::vector<std::string> inputs;
+    std::string cacheDir;
+    uint64_t cacheSize = 1ull << 30;
+    bool cacheHardlink = false;
+    // Set by -ftime-trace; empty means next to each output.
+    std::optional<std::string> timeTrace;
+    // Set by -fsave-optimization-record.
+    bool saveOptRecord = false;
+};
+
+static void usage(raw_ostream &out) {
+    out << "Usage: [OPTIONS] <INPUT_FILE> <OUTPUT_FILE>\n"
+        << "       [OPTIONS] <INPUT_FILE> -o <OUTPUT_FILE>\n"
+        << "       -c [OPTIONS] <INPUT_FILES...>\n"
+        << "       -h <INPUT_FILE> <OUTPUT_FILE>\n"
+        << "       --lto-link [OPTIONS] <INPUT_FILES...> -o <OUTPUT_FILE>\n"
+        << "       --server=<SOCKET> [-j <N>]\n"
+        << "       --connect=<SOCKET> <ARGS...>\n"
+        << "Modes:\n"
+        << "  -c                   Compile each input to an object in the working directory\n"
+        << "  -h                   Generate a declaration file of the functions; globals stay private\n"
+        << "  --lto-link           Link bitcode files produced with -flto; with several partitions (ThinLTO,\n"
+        << "                       or full LTO with -j > 1) the output file is an archive, not an object\n"
+        << "  --server=<SOCKET>    Serve compile requests on a Unix socket, keeping LLVM warm\n"
+        << "  --connect=<SOCKET>   Run the rest of the command line on a server\n"
+        << "Options:\n"
+        << "  -o <FILE>            Output file\n"
+        << "  -O<0-3>              Optimization level\n"
+        << "  -flto=thin|full      Emit LLVM bitcode for link-time optimization\n"
+        << "  -g                   Emit DWARF debug info with line tables, parameters and locals\n"
+        << "  -gline-tables-only   Emit only line tables, enough for profilers\n"
+        << "  -g0                  Emit no debug info (default)\n"
+        << "  -fprofile-generate[=<DIR>]\n"
+        << "                       Instrument for PGO; the program writes DIR/default_%m.profraw at exit\n"
+        << "                       and must be linked with the profile runtime (clang -fprofile-generate)\n"
+        << "  -fprofile-use=<FILE> Optimize with a profile merged by llvm-profdata (DIR/default.profdata\n"
+        << "                       when FILE is a directory)\n"
+        << "  -fprofile-sample-use=<FILE>\n"
+        << "                       Optimize with a sample profile, e.g. perf data of a -gline-tables-only\n"
+        << "                       build converted by llvm-profgen or create_llvm_prof\n"
+        << "  -fdebug-info-for-profiling\n"
+        << "                       Add discriminators to the line tables for sample profiling\n"
+        << "  -finstrument=counters|cycles\n"
+        << "                       Count calls (and cycles) of each function; link with -lclplrt, which\n"
+        << "                       prints them at exit and on SIGUSR1\n"
+        << "  -fno-strict-aliasing Let accesses of different types alias (-O2 and up assume they don't)\n"
+        << "  -fpipeline           Generate code for each declaration while parsing continues\n"
+        << "  --dump-ir            Print the unoptimized LLVM IR of each input\n"
+        << "  -ftime-report        Print time spent in each compiler phase and LLVM pass\n"
+        << "  -fmem-report         Print memory use of each compiler phase and data structure\n"
+        << "  -ftime-trace[=<FILE>]\n"
+        << "                       Write a Chrome trace of each compile to FILE or <OUTPUT>.json\n"
+        << "  -ftime-trace-granularity=<US>\n"
+        << "                       Drop trace spans shorter than US microseconds (default: 500)\n"
+        << "  -Rpass=<REGEX>       Report optimizations done by passes matching REGEX\n"
+        << "  -Rpass-missed=<REGEX>\n"
+        << "                       Report optimizations missed by passes matching REGEX\n"
+        << "  -Rpass-analysis=<REGEX>\n"
+        << "                       Report analyses of passes matching REGEX\n"
+        << "  -fsave-optimization-record[=yaml|bitstream]\n"
+        << "                       Save all remarks to <OUTPUT>.opt.yaml (or .opt.bitstream)\n"
+        << "  -j <N>               Number of parallel jobs (default: one per hardware thread)\n"
+        << "  --cache-dir=<DIR>    Reuse objects from (and add them to) a shared cache directory\n"
+        << "  --cache-size=<N>     Cache size limit in bytes, K/M/G suffixes allowed (default: 1G)\n"
+        << "  --cache-hardlink     Hardlink cache hits instead of copying; outputs must not be edited in place\n"
+        << "  --incremental-dir=<DIR>\n"
+        << "                       Reuse optimized IR of unchanged functions from a directory; skips\n"
+        << "                       most interprocedural optimization, so -O2/-O3 code may be slower\n";
+}
+
+static std::string optRecordPath(const std::string &output, const clpl::CompileOptions &options) {
+    SmallString<128> path(output);
+    sys::path::replace_extension(path, "opt." + options.optRecordFormat);
+    return std::string(path);
+}
+
+static std::string resolve(const clpl::DriverEnv &env, const std::string &path) {
+    if (env.workingDir.empty() || path.empty() || path == "-" || sys::path::is_absolute(path)) return path;
+
+    SmallString<256> out(env.workingDir);
+    sys::path::append(out, path);
+    return std::string(out);
+}
+
+static bool readFile(const std::string &path, std::string &contents) {
+    std::ifstream in(path);
+    if (!in) return false;
+
+    std::stringstream buf;
+    buf << in.rdbuf();
+    contents = buf.str();
+    return true;
+}
+
+static bool parseSize(const std::string &str, uint64_t &size) {
+    StringRef ref(str);
+    uint64_t scale = 1;
+    if (ref.endswith("K")) scale = 1ull << 10;
+    else if (ref.endswith("M")) scale = 1ull << 20;
+    else if (ref.endswith("G")) scale = 1ull << 30;
+    if (scale != 1) ref = ref.drop_back();
+
+    if (ref.getAsInteger(10, size)) return false;
+    size *= scale;
+    return true;
+}
+
+static bool parseUnsigned(const std::string &str, unsigned &value) {
+    return !StringRef(str).getAsInteger(10, value);
+}
+
+static bool parseArgs(const std::vector<std::string> &args, size_t first, DriverArgs &out, raw_ostream &diag) {
+    for (size_t i = first; i < args.size(); i++) {
+        auto &arg = args[i];
+        if (arg.size() == 3 && arg.starts_with("-O") && arg[2] >= '0' && arg[2] <= '3') {
+            out.options.optLevel = arg[2] - '0';
+        }
+        else if (arg == "-flto" || arg == "-flto=full") {
+            out.options.lto = clpl::LTOMode::Full;
+        }
+        else if (arg == "-flto=thin") {
+            out.options.lto = clpl::LTOMode::Thin;
+        }
+        else if (arg.starts_with("--cache-dir=")) {
+            out.cacheDir = arg.substr(strlen("--cache-dir="));
+        }
+        else if (arg == "--cache-hardlink") {
+            out.cacheHardlink = true;
+        }
+        else if (arg.starts_with("--incremental-dir=")) {
+            out.options.incrementalDir = arg.substr(strlen("--incremental-dir="));
+        }
+        else if (arg.starts_with("--cache-size=")) {
+            if (!parseSize(arg.substr(strlen("--cache-size=")), out.cacheSize)) {
+                diag << "\033[1;31mError: invalid cache size '" << arg << "'.\033[0m\n";
+                return false;
+            }
+        }
+        else if (arg == "-fstrict-aliasing" || arg == "-fno-strict-aliasing") {
+            out.options.strictAliasing = arg == "-fstrict-aliasing";
+        }
+        else if (arg == "-fpipeline") {
+            out.options.pipeline = true;
+        }
+        else if (arg == "-g") {
+            out.options.debugInfo = clpl::DebugInfoKind::Full;
+        }
+        else if (arg == "-gline-tables-only") {
+            out.options.debugInfo = clpl::DebugInfoKind::LineTablesOnly;
+        }
+        else if (arg == "-g0") {
+            out.options.debugInfo = clpl::DebugInfoKind::None;
+        }
+        else if (arg == "-fprofile-generate" || arg.starts_with("-fprofile-generate=")) {
+            // Same file name as clang, so the runtime's LLVM_PROFILE_FILE handling applies unchanged.
+            SmallString<256> path;
+            if (arg != "-fprofile-generate") path = arg.substr(strlen("-fprofile-generate="));
+            sys::path::append(path, "default_%m.profraw");
+            out.options.profileGenerate = std::string(path);
+        }
+        else if (arg.starts_with("-fprofile-use=")) {
+            out.options.profileUse = arg.substr(strlen("-fprofile-use="));
+        }
+        else if (arg.starts_with("-fprofile-sample-use=")) {
+            out.options.profileSampleUse = arg.substr(strlen("-fprofile-sample-use="));
+        }
+        else if (arg == "-fdebug-info-for-profiling") {
+            out.options.debugInfoForProfiling = true;
+        }
+        else if (arg == "-finstrument=counters") {
+            out.options.instrument = clpl::InstrumentKind::Counters;
+        }
+        else if (arg == "-finstrument=cycles") {
+            out.options.instrument = clpl::InstrumentKind::Cycles;
+        }
+        else if (arg == "--dump-ir") {
+            out.options.dumpIR = true;
+        }
+        else if (arg == "-ftime-report") {
+            out.options.timeReport = true;
+        }
+        else if (arg == "-fmem-report") {
+            out.options.memReport = true;
+        }
+        else if (arg == "-ftime-trace" || arg.starts_with("-ftime-trace=")) {
+            out.options.timeTrace = true;
+            out.timeTrace = arg == "-ftime-trace" ? "" : arg.substr(strlen("-ftime-trace="));
+        }
+        else if (arg.starts_with("-Rpass=")) {
+            out.options.remarksPassed = arg.substr(strlen("-Rpass="));
+        }
+        else if (arg.starts_with("-Rpass-missed=")) {
+            out.options.remarksMissed = arg.substr(strlen("-Rpass-missed="));
+        }
+        else if (arg.starts_with("-Rpass-analysis=")) {
+            out.options.remarksAnalysis = arg.substr(strlen("-Rpass-analysis="));
+        }
+        else if (arg == "-fsave-optimization-record" || arg.starts_with("-fsave-optimization-record=")) {
+            out.saveOptRecord = true;
+            if (arg != "-fsave-optimization-record") out.options.optRecordFormat = arg.substr(strlen("-fsave-optimization-record="));
+            if (out.options.optRecordFormat != "yaml" && out.options.optRecordFormat != "bitstream") {
+                diag << "\033[1;31mError: unknown optimization record format in '" << arg << "'.\033[0m\n";
+                return false;
+            }
+        }
+        else if (arg.starts_with("-ftime-trace-granularity=")) {
+            if (!parseUnsigned(arg.substr(strlen("-ftime-trace-granularity=")), out.options.timeTraceGranularity)) {
+                diag << "\033[1;31mError: invalid granularity in '" << arg << "'.\033[0m\n";
+                return false;
+            }
+        }
+        else if (arg == "-c") {
+            out.compileOnly = true;
+        }
+        else if (arg == "-j" || arg == "-o") {
+            if (i + 1 >= args.size()) {
+                diag << "\033[1;31mError: missing argument to '" << arg << "'.\033[0m\n";
+                return false;
+            }
+            if (arg == "-o") out.output = args[++i];
+            else if (!parseUnsigned(args[++i], out.jobs)) {
+                diag << "\033[1;31mError: invalid job count '" << args[i] << "'.\033[0m\n";
+                return false;
+            }
+        }
+        else if (arg.starts_with("-") && arg.size() > 1) {
+            diag << "\033[1;31mError: unknown option '" << arg << "'.\033[0m\n";
+            return false;
+        }
+        else out.inputs.push_back(arg);
+    }
+    return true;
+}
+
+static std::string objectPath(const std::string &input, const clpl::CompileOptions &options) {
+    SmallString<128> path(sys::path::filename(input));
+    sys::path::replace_extension(path, options.lto == clpl::LTOMode::None ? "o" : "bc");
+    return std::string(path);
+}
+
+bool clpl::compileFile(const CompileJob &job, const CompileOptions &options, raw_ostream &diag, const ObjectCache *cache) {
+    std::string source;
+    if (job.source) source = *job.source;
+    else if (!readFile(job.input, source)) {
+        diag << "\033[1;31mError: unable to read '" << job.input << "'.\033[0m\n";
+        return false;
+    }
+
+    auto jobOptions = options;
+    jobOptions.optRecordFile = job.optRecordFile;
+    // Named after the source so that remarks and debug info point into it.
+    auto sourceName = job.input == "-" ? "<stdin>" : job.input;
+
+    std::string key;
+    if (cache != nullptr) {
+        key = ObjectCache::computeKey(source, sourceName, jobOptions);
+        bool profiling = options.timeReport || options.timeTrace || options.memReport || jobOptions.remarksRequested();
+        if (!profiling && cache->fetch(key, job.output)) return true;
+    }
+    // The output may be a hardlink into the cache, never overwrite it in place.
+    sys::fs::remove(job.output);
+
+    auto result = compileToObject(source, jobOptions, sourceName);
+    diag << result.ir << result.remarks << result.timeReport << result.memReport;
+    if (options.timeTrace) {
+        std::error_code EC;
+        raw_fd_ostream trace(job.timeTraceFile, EC);
+        if (!EC) trace << result.timeTrace;
+        else diag << "\033[1;31mError: unable to write '" << job.timeTraceFile << "': " << EC.message() << ".\033[0m\n";
+    }
+    for (auto &d : result.diagnostics) diag << d.format() << "\n";
+    if (!result.success) {
+        diag << "\033[1;31mHad unrecoverable errors while compiling " << job.input << ".\033[0m\n";
+        return false;
+    }
+
+    std::error_code EC;
+    {
+        raw_fd_ostream dest(job.output, EC);
+        if (!EC) dest << StringRef(result.object.data(), result.object.size());
+    }
+    if (EC) {
+        diag << "\033[1;31mError: unable to write '" << job.output << "': " << EC.message() << ".\033[0m\n";
+        return false;
+    }
+
+    if (cache != nullptr) cache->store(key, job.output);
+    return true;
+}
+
+unsigned clpl::compileFiles(const std::vector<CompileJob> &jobs, const CompileOptions &options, unsigned threads, raw_ostream &diag, const ObjectCache *cache, ThreadPool *pool) {
+    if (jobs.size() == 1 && pool == nullptr) return compileFile(jobs[0], options, diag, cache) ? 0 : 1;
+
+    std::vector<std::string> messages(jobs.size());
+    std::vector<char> succeeded(jobs.size());
+    {
+        std::optional<ThreadPool> ownPool;
+        if (pool == nullptr) pool = &ownPool.emplace(hardware_concurrency(threads));
+        // Only this call's jobs are waited for; a shared pool runs other clients' too.
+        std::vector<std::shared_future<void>> done;
+        for (size_t i = 0; i < jobs.size(); i++) {
+            done.push_back(pool->async([&, i] {
+                raw_string_ostream os(messages[i]);
+                succeeded[i] = compileFile(jobs[i], options, os, cache);
+            }));
+        }
+        for (auto &f : done) f.wait();
+    }
+
+    unsigned failures = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        diag << messages[i];
+        if (!succeeded[i]) failures++;
+    }
+    return failures;
+}
+
+static int generateHeader(const std::vector<std::string> &args, raw_ostream &out, raw_ostream &diag, const clpl::DriverEnv &env) {
+    if (args.size() != 3) {
+        usage(out);
+        return 1;
+    }
+
+    std::string source;
+    if (!readFile(resolve(env, args[1]), source)) {
+        diag << "\033[1;31mError: unable to read '" << args[1] << "'.\033[0m\n";
+        return 1;
+    }
+
+    try {
+        clpl::Parser parser(source);
+        auto sts = parser.parse();
+
+        std::ofstream header(resolve(env, args[2]));
+        header << clpl::generateDeclarations(sts);
+    }
+    catch (clpl::ParseError &e) {
+        diag << e.msg << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+static int runLTOLink(const std::vector<std::string> &args, raw_ostream &out, raw_ostream &diag, const clpl::DriverEnv &env) {
+    DriverArgs dargs;
+    if (!parseArgs(args, 1, dargs, diag)) return 1;
+    if (dargs.inputs.empty() || dargs.output.empty()) {
+        usage(out);
+        return 1;
+    }
+
+    for (auto &in : dargs.inputs) in = resolve(env, in);
+    dargs.output = resolve(env, dargs.output);
+    dargs.options.profileSampleUse = resolve(env, dargs.options.profileSampleUse);
+    if (dargs.saveOptRecord) dargs.options.optRecordFile = optRecordPath(dargs.output, dargs.options);
+
+    try {
+        clpl::ltoLink(dargs.inputs, dargs.output, dargs.options, dargs.jobs);
+    }
+    catch (clpl::LinkError &e) {
+        diag << "\033[1;31mError: " << e.msg << "\033[0m\n";
+        return 1;
+    }
+    return 0;
+}
+
+int clpl::runServerMode(const std::vector<std::string> &args, raw_ostream &out, raw_ostream &diag) {
+    unsigned jobs = 0;
+    if (args.size() == 3 && args[1] == "-j") {
+        if (!parseUnsigned(args[2], jobs)) {
+            diag << "\033[1;31mError: invalid job count '" << args[2] << "'.\033[0m\n";
+            return 1;
+        }
+    }
+    else if (args.size() != 1) {
+        usage(out);
+        return 1;
+    }
+    return runServer(args[0].substr(strlen("--server=")), jobs, diag);
+}
+
+int clpl::runDriver(const std::vector<std::string> &args, raw_ostream &out, raw_ostream &diag, const DriverEnv &env) {
+    if (args.empty()) {
+        usage(out);
+        return 1;
+    }
+    if (args[0] == "-h") return generateHeader(args, out, diag, env);
+    if (args[0] == "--lto-link") return runLTOLink(args, out, diag, env);
+
+    DriverArgs dargs;
+    if (!parseArgs(args, 0, dargs, diag)) return 1;
+    bool readsStdin = std::find(dargs.inputs.begin(), dargs.inputs.end(), "-") != dargs.inputs.end();
+    if (dargs.compileOnly && dargs.output.empty() && readsStdin) {
+        diag << "\033[1;31mError: compiling standard input requires -o.\033[0m\n";
+        return 1;
+    }
+
+    int profiles = !dargs.options.profileGenerate.empty() + !dargs.options.profileUse.empty() + !dargs.options.profileSampleUse.empty();
+    if (profiles > 1) {
+        diag << "\033[1;31mError: -fprofile-generate, -fprofile-use and -fprofile-sample-use are mutually exclusive.\033[0m\n";
+        return 1;
+    }
+
+    if (dargs.timeTrace && !dargs.timeTrace->empty() && dargs.inputs.size() > 1) {
+        diag << "\033[1;31mError: -ftime-trace=<FILE> takes a single input.\033[0m\n";
+        return 1;
+    }
+
+    std::vector<CompileJob> jobs;
+    if (dargs.compileOnly) {
+        if (dargs.inputs.empty() || (!dargs.output.empty() && dargs.inputs.size() > 1)) {
+            usage(out);
+            return 1;
+        }
+        for (auto &in : dargs.inputs) {
+            jobs.push_back({in, dargs.output.empty() ? objectPath(in, dargs.options) : dargs.output});
+        }
+    }
+    else if (dargs.inputs.size() == 1 && !dargs.output.empty()) {
+        jobs.push_back({dargs.inputs[0], dargs.output});
+    }
+    else if (dargs.inputs.size() == 2 && dargs.output.empty()) {
+        jobs.push_back({dargs.inputs[0], dargs.inputs[1]});
+    }
+    else {
+        usage(out);
+        return 1;
+    }
+
+    for (auto &job : jobs) {
+        if (job.input == "-") {
+            if (env.stdinData) job.source = *env.stdinData;
+            else {
+                std::stringstream buf;
+                buf << std::cin.rdbuf();
+                job.source = buf.str();
+            }
+        }
+        job.input = resolve(env, job.input);
+        job.output = resolve(env, job.output);
+        if (dargs.saveOptRecord) job.optRecordFile = optRecordPath(job.output, dargs.options);
+        if (dargs.timeTrace) job.timeTraceFile = dargs.timeTrace->empty() ? job.output + ".json" : resolve(env, *dargs.timeTrace);
+    }
+    dargs.cacheDir = resolve(env, dargs.cacheDir);
+    dargs.options.incrementalDir = resolve(env, dargs.options.incrementalDir);
+    if (!dargs.options.profileUse.empty()) {
+        SmallString<256> profile(resolve(env, dargs.options.profileUse));
+        if (sys::fs::is_directory(profile)) sys::path::append(profile, "default.profdata");
+        dargs.options.profileUse = std::string(profile);
+    }
+    dargs.options.profileSampleUse = resolve(env, dargs.options.profileSampleUse);
+    dargs.options.compilationDir = env.workingDir;
+
+    std::unique_ptr<ObjectCache> cache;
+    if (!dargs.cacheDir.empty()) cache = std::make_unique<ObjectCache>(dargs.cacheDir, dargs.cacheSize, dargs.cacheHardlink);
+
+    auto failures = compileFiles(jobs, dargs.options, dargs.jobs, diag, cache.get(), env.pool);
+
+    if (cache != nullptr) cache->prune();
+    if (!dargs.options.incrementalDir.empty()) FunctionCache(dargs.options.incrementalDir).prune(dargs.cacheSize);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <llvm/Support/raw_ostream.h>
+
+#include "compiler.hpp"
+#include "cache.hpp"
+
+namespace llvm {
+    class ThreadPool;
+}
+
+namespace clpl {
+    struct CompileJob {
+        std::string input;
+        std::string output;
+        // Source text to compile instead of reading input.
+        std::optional<std::string> source = std::nullopt;
+        // Where to write the Chrome trace when CompileOptions::timeTrace is set.
+        std::string timeTraceFile = {};
+        // Where to save optimization remarks with -fsave-optimization-record; empty for none.
+        std::string optRecordFile = {};
+    };
+
+    struct DriverEnv {
+        // Relative paths are resolved against this directory instead of the process one.
+        std::string workingDir;
+        // Contents of the "-" input; read from standard input when unset.
+        std::optional<std::string> stdinData;
+        // Pool to compile on, shared with other invocations, instead of one of -j threads.
+        llvm::ThreadPool *pool = nullptr;
+    };
+
+    // Reads, parses and compiles a single file. Errors are reported to diag; returns false on failure.
+    // With a cache, an up-to-date object is taken from it instead of compiling, unless a report, trace or remarks were requested.
+    bool compileFile(const CompileJob &job, const CompileOptions &options, llvm::raw_ostream &diag, const ObjectCache *cache = nullptr);
+
+    // Compiles every job on a pool of worker threads (0 = one per hardware thread), each with its own
+    // Parser/Compiler/LLVMContext. Diagnostics are written in job order. Returns the number of failures.
+    // With a shared pool, every job runs there and threads is ignored.
+    unsigned compileFiles(const std::vector<CompileJob> &jobs, const CompileOptions &options, unsigned threads, llvm::raw_ostream &diag, const ObjectCache *cache = nullptr, llvm::ThreadPool *pool = nullptr);
+
+    // Entry point of clplc --server=<SOCKET> [-j <N>], with args[0] the --server option.
+    int runServerMode(const std::vector<std::string> &args, llvm::raw_ostream &out, llvm::raw_ostream &diag);
+
+    // Entry point of clplc: args excludes the program name. Returns the process exit code.
+    int runDriver(const std::vector<std::string> &args, llvm::raw_ostream &out, llvm::raw_ostream &diag, const DriverEnv &env = {});
+}
@@ -0,0 +1,241 @@
+#include "server.hpp"
+#include "driver.hpp"
+#include "target.hpp"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace llvm;
+
+/*
+    Wire format, all integers are native endian uint32_t and strings are length prefixed:
+        request:  cwd, hasStdin, [stdin], argc, args...
+        response: exit code, stdout, stderr
+*/
+
+static bool writeAll(int fd, const void *data, size_t size) {
+    auto *ptr = static_cast<const char*>(data);
+    while (size > 0) {
+        auto n = ::write(fd, ptr, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void *data, size_t size) {
+    auto *ptr = static_cast<char*>(data);
+    while (size > 0) {
+        auto n = ::read(fd, ptr, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool writeU32(int fd, uint32_t val) {
+    return writeAll(fd, &val, sizeof(val));
+}
+
+static bool readU32(int fd, uint32_t &val) {
+    return readAll(fd, &val, sizeof(val));
+}
+
+static bool writeString(int fd, const std::string &str) {
+    return writeU32(fd, str.size()) && writeAll(fd, str.data(), str.size());
+}
+
+// Bounds on what a request may contain, so a malformed one can't exhaust memory.
+static const uint32_t maxStringSize = 256u << 20;
+static const uint32_t maxArgs = 1u << 16;
+
+static bool readString(int fd, std::string &str) {
+    uint32_t size;
+    if (!readU32(fd, size) || size > maxStringSize) return false;
+    str.resize(size);
+    return readAll(fd, str.data(), size);
+}
+
+static bool makeAddress(const std::string &path, sockaddr_un &addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+// Requests run with the server's rights, so only its own user may send them.
+static bool isOwnUser(int fd) {
+    ucred cred;
+    socklen_t size = sizeof(cred);
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) == 0 && cred.uid == ::geteuid();
+}
+
+static void handleConnection(int fd, ThreadPool &compilePool) {
+    if (!isOwnUser(fd)) {
+        ::close(fd);
+        return;
+    }
+
+    std::string cwd, stdinData;
+    uint32_t hasStdin, argc;
+    std::vector<std::string> args;
+
+    bool ok = readString(fd, cwd) && readU32(fd, hasStdin) && (!hasStdin || readString(fd, stdinData)) && readU32(fd, argc) && argc <= maxArgs;
+    for (uint32_t i = 0; ok && i < argc; i++) {
+        ok = readString(fd, args.emplace_back());
+    }
+    if (!ok) {
+        ::close(fd);
+        return;
+    }
+
+    clpl::DriverEnv env;
+    env.workingDir = cwd;
+    env.pool = &compilePool;
+    if (hasStdin) env.stdinData = std::move(stdinData);
+
+    std::string outText, diagText;
+    int code;
+    // Whatever one request throws is that request's failure, not the server's.
+    try {
+        raw_string_ostream out(outText), diag(diagText);
+        code = clpl::runDriver(args, out, diag, env);
+    }
+    catch (std::exception &e) {
+        code = 1;
+        diagText += "\033[1;31mError: " + std::string(e.what()) + ".\033[0m\n";
+    }
+    catch (...) {
+        code = 1;
+        diagText += "\033[1;31mError: internal compiler error.\033[0m\n";
+    }
+
+    writeU32(fd, code);
+    writeString(fd, outText);
+    writeString(fd, diagText);
+    ::close(fd);
+}
+
+int clpl::runServer(const std::string &socketPath, unsigned jobs, raw_ostream &diag) {
+    sockaddr_un addr;
+    if (!makeAddress(socketPath, addr)) {
+        diag << "\033[1;31mError: socket path '" << socketPath << "' is too long.\033[0m\n";
+        return 1;
+    }
+
+    int sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        diag << "\033[1;31mError: unable to create socket: " << std::strerror(errno) << ".\033[0m\n";
+        return 1;
+    }
+
+    // Only a stale socket may be replaced: not some other file, nor the socket of a live server.
+    struct stat st;
+    if (::lstat(socketPath.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            diag << "\033[1;31mError: '" << socketPath << "' exists and is not a socket.\033[0m\n";
+            ::close(sock);
+            return 1;
+        }
+        int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool live = probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        if (probe >= 0) ::close(probe);
+        if (live) {
+            diag << "\033[1;31mError: a server is already listening on '" << socketPath << "'.\033[0m\n";
+            ::close(sock);
+            return 1;
+        }
+        ::unlink(socketPath.c_str());
+    }
+    // Created 0600 from the start: a chmod after bind would leave a window open to other users.
+    auto mask = ::umask(0177);
+    bool bound = ::bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    ::umask(mask);
+    if (!bound || ::listen(sock, SOMAXCONN) < 0) {
+        diag << "\033[1;31mError: unable to listen on '" << socketPath << "': " << std::strerror(errno) << ".\033[0m\n";
+        ::close(sock);
+        return 1;
+    }
+
+    // Clients hanging up early must not take the server down.
+    std::signal(SIGPIPE, SIG_IGN);
+    initializeNativeTarget();
+
+    // Compile jobs of all clients share one pool, so concurrent clients don't oversubscribe the
+    // machine; connections only wait for their jobs.
+    ThreadPool compilePool(hardware_concurrency(jobs));
+    ThreadPool pool(hardware_concurrency(jobs));
+    while (true) {
+        int fd = ::accept4(sock, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            diag << "\033[1;31mError: accept failed: " << std::strerror(errno) << ".\033[0m\n";
+            break;
+        }
+        pool.async([fd, &compilePool] { handleConnection(fd, compilePool); });
+    }
+
+    pool.wait();
+    compilePool.wait();
+    ::close(sock);
+    ::unlink(socketPath.c_str());
+    return 1;
+}
+
+int clpl::runClient(const std::string &socketPath, const std::vector<std::string> &args) {
+    sockaddr_un addr;
+    int sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0 || !makeAddress(socketPath, addr) || ::connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        if (sock >= 0) ::close(sock);
+        return runDriver(args, outs(), errs());
+    }
+
+    SmallString<256> cwd;
+    sys::fs::current_path(cwd);
+
+    bool readsStdin = std::find(args.begin(), args.end(), "-") != args.end();
+    std::string stdinData;
+    if (readsStdin) {
+        std::stringstream buf;
+        buf << std::cin.rdbuf();
+        stdinData = buf.str();
+    }
+
+    bool ok = writeString(sock, std::string(cwd)) && writeU32(sock, readsStdin) && (!readsStdin || writeString(sock, stdinData)) && writeU32(sock, args.size());
+    for (size_t i = 0; ok && i < args.size(); i++) {
+        ok = writeString(sock, args[i]);
+    }
+
+    uint32_t code;
+    std::string outText, diagText;
+    ok = ok && readU32(sock, code) && readString(sock, outText) && readString(sock, diagText);
+    ::close(sock);
+
+    if (!ok) {
+        errs() << "\033[1;31mError: lost connection to the compile server.\033[0m\n";
+        return 1;
+    }
+    outs() << outText;
+    errs() << diagText;
+    return code;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <llvm/Support/raw_ostream.h>
+
+namespace clpl {
+    // Serves compile requests on a Unix domain socket until killed, with warm LLVM state. Up to
+    // `jobs` requests (0 = one per hardware thread) are served at once, and their files compile on
+    // one shared pool of as many threads.
+    int runServer(const std::string &socketPath, unsigned jobs, llvm::raw_ostream &diag);
+
+    // Forwards a clplc invocation to a server, together with the working directory and, if an input
+    // is "-", standard input. Falls back to compiling in-process when no server is listening.
+    int runClient(const std::string &socketPath, const std::vector<std::string> &args);
+}
@@ -1,43 +1,22 @@
-#include <iostream>
-#include "parser.hpp"
-#include "compiler.hpp"
+#include "driver.hpp"
+#include "server.hpp"
 
-#include <sstream>
-#include <fstream>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstring>
 
 int main(int argc, char **argv) {
-    if (argc == 1) {
-        std::cout << "Usage: [MODE] <INPUT_FILE> <OUTPUT_FILE>\n";
-        return 1;
-    }
     std::vector<std::string> args;
     for (int i = 1; i < argc; i++) {
         args.push_back(std::string(argv[i]));
     }
 
-    if (args[0] == "-h") {
-        std::ifstream in(args.at(1));
-        std::stringstream buf;
-        buf << in.rdbuf();
-
-        clpl::Parser parser(buf.str());
-        auto sts = parser.parse();
-
-        std::ofstream out(args.at(2));
-        out << clpl::generateDeclarations(sts);
-    }
-    else {
-        std::ifstream in(args.at(0));
-        std::stringstream buf;
-        buf << in.rdbuf();
-
-        clpl::Parser parser(buf.str());
-        auto sts = parser.parse();
-
-        clpl::Compiler compiler(args.at(1).c_str(), sts);
-        compiler.compile();
-        compiler.output(args.at(1).c_str());
+    if (!args.empty() && args[0].starts_with("--server=")) return clpl::runServerMode(args, llvm::outs(), llvm::errs());
+    if (!args.empty() && args[0].starts_with("--connect=")) {
+        auto socketPath = args[0].substr(strlen("--connect="));
+        args.erase(args.begin());
+        return clpl::runClient(socketPath, args);
     }
 
-    return 0;
-}
\ No newline at end of file
+    return clpl::runDriver(args, llvm::outs(), llvm::errs());
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <typeinfo>
+
+namespace clpl {
+    // Told about every AST node and type the parser allocates; pass one to the Parser constructor.
+    struct AllocationHook {
+        virtual ~AllocationHook() = default;
+        // bytes includes the shared_ptr control block allocated along with the node.
+        virtual void allocated(const std::type_info &node, size_t bytes) = 0;
+    };
+
+    // std::allocator that reports each allocation to a hook, for use with std::allocate_shared.
+    template<class T>
+    struct CountingAllocator {
+        using value_type = T;
+
+        AllocationHook *hook;
+        const std::type_info *node;
+
+        CountingAllocator(AllocationHook *hook, const std::type_info &node) : hook(hook), node(&node) { }
+
+        template<class U>
+        CountingAllocator(const CountingAllocator<U> &other) : hook(other.hook), node(other.node) { }
+
+        T *allocate(size_t n) {
+            hook->allocated(*node, n * sizeof(T));
+            return std::allocator<T>().allocate(n);
+        }
+
+        void deallocate(T *p, size_t n) {
+            std::allocator<T>().deallocate(p, n);
+        }
+
+        template<class U>
+        bool operator==(const CountingAllocator<U> &other) const { return hook == other.hook; }
+    };
+}
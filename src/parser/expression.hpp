@@ -7,11 +7,15 @@
 namespace clpl {
     struct Expr {
         TypeSP type = nullptr;
+        // Position of the token the expression is attributed to, e.g. the operator of a binary one.
+        int line = 0, column = 0;
         virtual ~Expr() = default;
         
         explicit Expr() = default;
         explicit Expr(const Expr &e) {
             type = e.type;
+            line = e.line;
+            column = e.column;
         }
     };
 
@@ -68,6 +72,27 @@ namespace clpl {
 
     typedef std::shared_ptr<AssignExpr> AssignExprSP;
 
+    // target[index] on an indexed pointer (T[]).
+    struct IndexExpr : public Expr {
+        ExprSP target;
+        ExprSP index;
+
+        IndexExpr(ExprSP target, ExprSP index) : target(std::move(target)), index(std::move(index)) { }
+    };
+
+    typedef std::shared_ptr<IndexExpr> IndexExprSP;
+
+    // Constant elements. At global scope the expression points to a read-only table unless the literal
+    // is followed by `mutable`; inside a function it points to a fresh writable copy.
+    struct ArrayLiteralExpr : public Expr {
+        std::vector<ExprSP> elements;
+        bool writable = false;
+
+        explicit ArrayLiteralExpr(const std::vector<ExprSP> &elements) : elements(elements) { }
+    };
+
+    typedef std::shared_ptr<ArrayLiteralExpr> ArrayLiteralExprSP;
+
     struct CallExpr : public Expr {
         ExprSP callee;
         std::vector<ExprSP> args;
@@ -2,28 +2,33 @@
 
 #include "scanner.hpp"
 
-#include <iostream>
+#include <unordered_set>
 
 using namespace clpl;
 
-Parser::Parser(const std::string &src) {
+Parser::Parser(const std::string &src, AllocationHook *allocationHook) : allocationHook(allocationHook) {
     source = src;
-    tokens = Scanner(src).tokenize();
+    try {
+        tokens = Scanner(src).tokenize();
+    }
+    catch (ScanError &e) {
+        throw ParseError("\033[1;31mError: (at line " + std::to_string(e.line) + ")\033[0m\n\t\033[1m" + e.msg + "\033[0m", e.line, e.msg);
+    }
 
     nTypes = {
-        {"void", std::make_shared<NamedType>("void")},
-        {"bool", std::make_shared<NamedType>("bool")},
-        {"i8", std::make_shared<NamedType>("i8")},
-        {"i16", std::make_shared<NamedType>("i16")},
-        {"i32", std::make_shared<NamedType>("i32")},
-        {"i64", std::make_shared<NamedType>("i64")},
-        {"u8", std::make_shared<NamedType>("u8")},
-        {"u16", std::make_shared<NamedType>("u16")},
-        {"u32", std::make_shared<NamedType>("u32")},
-        {"u64", std::make_shared<NamedType>("u64")},
-        {"f32", std::make_shared<NamedType>("f32")},
-        {"f64", std::make_shared<NamedType>("f64")},
-        {"ptr", std::make_shared<NamedType>("ptr")},
+        {"void", make<NamedType>("void")},
+        {"bool", make<NamedType>("bool")},
+        {"i8", make<NamedType>("i8")},
+        {"i16", make<NamedType>("i16")},
+        {"i32", make<NamedType>("i32")},
+        {"i64", make<NamedType>("i64")},
+        {"u8", make<NamedType>("u8")},
+        {"u16", make<NamedType>("u16")},
+        {"u32", make<NamedType>("u32")},
+        {"u64", make<NamedType>("u64")},
+        {"f32", make<NamedType>("f32")},
+        {"f64", make<NamedType>("f64")},
+        {"ptr", make<NamedType>("ptr")},
     };
 
     identTypes.emplace_back();
@@ -31,23 +36,33 @@ Parser::Parser(const std::string &src) {
 
 SList Parser::parse() {
     SList statements;
-    while (!isAtEnd()) {
-        try {
-            statements.push_back(topLevelStatement());
-        }
-        catch (ParseError &e) {
-            hadErrors = true;
-            std::cerr << e.msg << "\n";
-            break;
-        }
-    }
-    if (hadErrors) {
-        std::cerr << "\033[1;31mHad unrecoverable errors while parsing this file.\033[0m\n";
-        std::exit(EXIT_FAILURE);
+    while (auto st = parseNext()) {
+        statements.push_back(st);
     }
     return statements;
 }
 
+ParserStats Parser::stats() const {
+    ParserStats out;
+    out.tokens = tokens.size();
+    out.tokenBytes = tokens.capacity() * sizeof(Token);
+    // Only strings too long for the small-string buffer own heap memory.
+    auto inlineCapacity = std::string().capacity();
+    for (auto &tok : tokens) {
+        if (tok.identName.capacity() > inlineCapacity) out.tokenBytes += tok.identName.capacity() + 1;
+        if (tok.strValue.capacity() > inlineCapacity) out.tokenBytes += tok.strValue.capacity() + 1;
+    }
+    out.types = nTypes.size();
+    out.functions = funcs.size();
+    out.globals = identTypes.front().size();
+    return out;
+}
+
+StmtSP Parser::parseNext() {
+    if (isAtEnd()) return nullptr;
+    return topLevelStatement();
+}
+
 StmtSP Parser::topLevelStatement() {
     return declaration();
 }
@@ -75,6 +90,16 @@ StmtSP Parser::functionDecl() {
         auto ptype = parseType();
 
         ParameterT param = {ptype, pname};
+        while (check(TokenT::IDENTIFIER)) {
+            auto &qualifier = advance();
+            if (qualifier.identName == "restrict") param.restrict = true;
+            else if (qualifier.identName == "nocapture") param.nocapture = true;
+            else if (qualifier.identName == "readonly") param.readonly = true;
+            else throw error(qualifier, "Unknown parameter qualifier.");
+            // Everything that is passed as an address: pointers, ptr and function references.
+            bool isPointer = instanceof<PointerType>(ptype) || instanceof<FunctionReferenceType>(ptype) || (instanceof<NamedType>(ptype) && downcast<NamedType>(ptype)->name.identName == "ptr");
+            if (!isPointer) throw error(qualifier, "Only pointer parameters can be qualified.");
+        }
         params.push_back(param);
         paramTypes.push_back(ptype);
     } while (match(TokenT::COMMA));
@@ -86,7 +111,7 @@ StmtSP Parser::functionDecl() {
     }
 
     if (!exists(name.identName)) {
-        auto ftype = std::make_shared<FunctionReferenceType>(rtype, paramTypes);
+        auto ftype = make<FunctionReferenceType>(rtype, paramTypes);
         identTypes[scopeCount].insert({name.identName, ftype});
     }
     else if (funcs.at(name.identName)->body == nullptr) {
@@ -96,12 +121,12 @@ StmtSP Parser::functionDecl() {
 
     StmtSP fbody = nullptr;
     if (match(TokenT::LEFT_CUR)) {
-        scopeStack.push_back(std::make_shared<FuncDeclStmt>(rtype, name, params, nullptr));
+        scopeStack.push_back(make<FuncDeclStmt>(rtype, name, params, nullptr));
         fbody = blockStatement(params);
         scopeStack.pop_back();
     }
     else consume(TokenT::SEMICOLON, "Expected ';' after external (bodyless) function declaration.");
-    auto out = std::make_shared<FuncDeclStmt>(rtype, name, params, fbody);
+    auto out = located(make<FuncDeclStmt>(rtype, name, params, fbody), name);
     funcs.insert_or_assign(out->name.identName, out);
     return out;
 }
@@ -114,13 +139,29 @@ StmtSP Parser::variableDecl() {
     ExprSP value = nullptr;
     if (match(TokenT::ASSIGN)) value = expression();
     consume(TokenT::SEMICOLON, "Expected ';' after variable declaration.");
+    fitArrayLiteral(value, vartype);
     if (!exists(name.identName)) {
         identTypes[scopeCount].insert({name.identName, vartype});
     }
     else {
         throw error(name, "Variable already defined.");
     }
-    return std::make_shared<VarDeclStmt>(vartype, name, value);
+    return located(make<VarDeclStmt>(vartype, name, value), name);
+}
+
+// An array literal bound to an indexed pointer takes its element type, row by row, so that the
+// elements are converted to it. Without such a target it keeps the type of its first element.
+void Parser::fitArrayLiteral(const ExprSP &value, const TypeSP &target) {
+    if (!instanceof<ArrayLiteralExpr>(value) || !instanceof<IndexedPointerType>(target)) return;
+    value->type = target;
+
+    auto elementType = downcast<IndexedPointerType>(target)->dataType;
+    for (auto &e : downcast<ArrayLiteralExpr>(value)->elements) {
+        if (instanceof<ArrayLiteralExpr>(e) && !instanceof<IndexedPointerType>(elementType)) {
+            throw error(previous(), "Array literal in place of an element of type '" + elementType->toString() + "'.");
+        }
+        fitArrayLiteral(e, elementType);
+    }
 }
 
 StmtSP Parser::statement() {
@@ -137,15 +178,18 @@ StmtSP Parser::statement() {
 }
 
 StmtSP Parser::forStatement() {
+    auto &keyword = previous();
     consume(TokenT::LEFT_PAREN, "Expected '(' after 'for'.");
-    scopeStack.push_back(std::make_shared<ForStmt>());
+    scopeStack.push_back(make<ForStmt>());
     StmtSP init;
     if (checkForm({TokenT::IDENTIFIER, TokenT::COLON})) {
         auto name = consume(TokenT::IDENTIFIER, "Expected identifier.");
         consume(TokenT::COLON, "Expected ':'.");
         auto type = parseType();
         consume(TokenT::ASSIGN, "Expected assignment in for-loop initializer.");
-        init = std::make_shared<VarDeclStmt>(type, name, expression());
+        auto value = expression();
+        fitArrayLiteral(value, type);
+        init = located(make<VarDeclStmt>(type, name, value), name);
         consume(TokenT::SEMICOLON, "Expected ';' after for-loop initializer statement.");
     }
     else if (match(TokenT::SEMICOLON)) {
@@ -165,12 +209,13 @@ StmtSP Parser::forStatement() {
 
     StmtSP body = statement();
     scopeStack.pop_back();
-    return std::make_shared<ForStmt>(init, condition, increment, body);
+    return located(make<ForStmt>(init, condition, increment, body), keyword);
 }
 
 StmtSP Parser::ifStatement() {
+    auto &keyword = previous();
     consume(TokenT::LEFT_PAREN, "Expected '(' after 'if'.");
-    scopeStack.push_back(std::make_shared<IfStmt>());
+    scopeStack.push_back(make<IfStmt>());
 
     ExprSP condition = expression();
     consume(TokenT::RIGHT_PAREN, "Expected ')' after condition.");
@@ -180,31 +225,37 @@ StmtSP Parser::ifStatement() {
         elseBody = statement();
     }
     scopeStack.pop_back();
-    return std::make_shared<IfStmt>(condition, ifBody, elseBody);
+    return located(make<IfStmt>(condition, ifBody, elseBody), keyword);
 }
 
 StmtSP Parser::returnStatement() {
+    auto &keyword = previous();
     ExprSP value = nullptr;
     if (!check(TokenT::SEMICOLON)) {
         value = expression();
     }
 
     consume(TokenT::SEMICOLON, "Expected ';' after return value.");
-    return std::make_shared<ReturnStmt>(value);
+    if (!scopeStack.empty() && instanceof<FuncDeclStmt>(scopeStack.front())) {
+        fitArrayLiteral(value, downcast<FuncDeclStmt>(scopeStack.front())->type);
+    }
+    return located(make<ReturnStmt>(value), keyword);
 }
 
 StmtSP Parser::whileStatement() {
+    auto &keyword = previous();
     consume(TokenT::LEFT_PAREN, "Expected '(' after 'while'.");
-    scopeStack.push_back(std::make_shared<WhileStmt>());
+    scopeStack.push_back(make<WhileStmt>());
     ExprSP condition = expression();
     consume(TokenT::RIGHT_PAREN, "Expected ')' after condition.");
     StmtSP body = statement();
     scopeStack.pop_back();
-    return std::make_shared<WhileStmt>(condition, body);
+    return located(make<WhileStmt>(condition, body), keyword);
 }
 
 StmtSP Parser::blockStatement(const std::vector<ParameterT> &params) {
-    scopeStack.push_back(std::make_shared<BlockStmt>());
+    auto &brace = previous();
+    scopeStack.push_back(make<BlockStmt>());
     identTypes.emplace_back();
     scopeCount++;
 
@@ -225,13 +276,13 @@ StmtSP Parser::blockStatement(const std::vector<ParameterT> &params) {
     scopeStack.pop_back();
     identTypes.pop_back();
     scopeCount--;
-    return std::make_shared<BlockStmt>(body);
+    return located(make<BlockStmt>(body), brace);
 }
 
 StmtSP Parser::breakStatement() {
     if (isInsideScopeOf<WhileStmt>() || isInsideScopeOf<ForStmt>()) {
         consume(TokenT::SEMICOLON, "Expected ';'.");
-        return std::make_shared<BreakStmt>();
+        return located(make<BreakStmt>(), previous());
     }
     else throw error(previous(), "Break statement needs to be inside a loop.");
 }
@@ -239,13 +290,14 @@ StmtSP Parser::breakStatement() {
 StmtSP Parser::continueStatement() {
     if (isInsideScopeOf<WhileStmt>() || isInsideScopeOf<ForStmt>()) {
         consume(TokenT::SEMICOLON, "Expected ';'.");
-        return std::make_shared<ContinueStmt>();
+        return located(make<ContinueStmt>(), previous());
     }
     else throw error(previous(), "Continue statement needs to be inside a loop.");
 }
 
 StmtSP Parser::expressionStatement() {
-    auto expr = std::make_shared<ExprStmt>(expression());
+    auto &start = peek();
+    auto expr = located(make<ExprStmt>(expression()), start);
     consume(TokenT::SEMICOLON, "Expected ';'.");
     return expr;
 }
@@ -261,8 +313,9 @@ ExprSP Parser::assignment() {
         auto equals = previous();
         auto value = assignment();
 
-        if (instanceof<IdentifierExpr>(expr)) {
-            expr = std::make_shared<AssignExpr>(expr, value);
+        if (instanceof<IdentifierExpr>(expr) || instanceof<IndexExpr>(expr)) {
+            fitArrayLiteral(value, expr->type);
+            expr = located(make<AssignExpr>(expr, value), equals);
             expr->type = value->type;
             return expr;
         }
@@ -275,9 +328,9 @@ ExprSP Parser::orExpr() {
     auto expr = andExpr();
 
     while (match(TokenT::OR)) {
-        auto op = previous().type;
+        auto &op = previous();
         auto rhs = andExpr();
-        expr = std::make_shared<BinaryExpr>(expr, rhs, op);
+        expr = located(make<BinaryExpr>(expr, rhs, op.type), op);
         expr->type = nTypes.at("bool");
     }
     return expr;
@@ -287,9 +340,9 @@ ExprSP Parser::andExpr() {
     auto expr = eqExpr();
 
     while (match(TokenT::AND)) {
-        auto op = previous().type;
+        auto &op = previous();
         auto rhs = eqExpr();
-        expr = std::make_shared<BinaryExpr>(expr, rhs, op);
+        expr = located(make<BinaryExpr>(expr, rhs, op.type), op);
         expr->type = nTypes.at("bool");
     }
     return expr;
@@ -299,12 +352,12 @@ ExprSP Parser::eqExpr() {
     auto expr = compExpr();
 
     while (match({TokenT::EQ, TokenT::NOT_EQ})) {
-        auto op = previous().type;
+        auto &op = previous();
         auto rhs = compExpr();
         if (expr->type->toString() != rhs->type->toString()) {
             throw error(peek(), "Types must be the same.");
         }
-        expr = std::make_shared<BinaryExpr>(expr, rhs, op);
+        expr = located(make<BinaryExpr>(expr, rhs, op.type), op);
         expr->type = nTypes.at("bool");
     }
     return expr;
@@ -314,12 +367,12 @@ ExprSP Parser::compExpr() {
     auto expr = addition();
 
     while (match({TokenT::GT, TokenT::LT, TokenT::GEQ, TokenT::LEQ})) {
-        auto op = previous().type;
+        auto &op = previous();
         auto rhs = addition();
         if (expr->type->toString() != rhs->type->toString()) {
             throw error(peek(), "Types must be the same.");
         }
-        expr = std::make_shared<BinaryExpr>(expr, rhs, op);
+        expr = located(make<BinaryExpr>(expr, rhs, op.type), op);
         expr->type = rhs->type;
     }
     return expr;
@@ -329,13 +382,13 @@ ExprSP Parser::addition() {
     auto expr = multiplication();
 
     while (match({TokenT::PLUS, TokenT::MINUS})) {
-        auto op = previous().type;
+        auto &op = previous();
         auto rhs = multiplication();
 
         if (expr->type->toString() != rhs->type->toString()) {
             throw error(peek(), "Types must be the same.");
         }
-        expr = std::make_shared<BinaryExpr>(expr, rhs, op);
+        expr = located(make<BinaryExpr>(expr, rhs, op.type), op);
         expr->type = rhs->type;
     }
     return expr;
@@ -345,13 +398,13 @@ ExprSP Parser::multiplication() {
     auto expr = unary();
 
     while (match({TokenT::STAR, TokenT::SLASH, TokenT::MOD})) {
-        auto op = previous().type;
+        auto &op = previous();
         auto rhs = unary();
 
         if (expr->type->toString() != rhs->type->toString()) {
             throw error(peek(), "Types must be the same.");
         }
-        expr = std::make_shared<BinaryExpr>(expr, rhs, op);
+        expr = located(make<BinaryExpr>(expr, rhs, op.type), op);
         expr->type = rhs->type;
     }
     return expr;
@@ -359,9 +412,9 @@ ExprSP Parser::multiplication() {
 
 ExprSP Parser::unary() {
     if (match({TokenT::NOT, TokenT::MINUS})) {
-        auto op = previous().type;
+        auto &op = previous();
         auto rhs = unary();
-        auto expr = std::make_shared<UnaryExpr>(rhs, op);
+        auto expr = located(make<UnaryExpr>(rhs, op.type), op);
         expr->type = rhs->type;
         return expr;
     }
@@ -373,12 +426,14 @@ ExprSP Parser::memberOpExpr() {
 
     while (true) {
         if (match(TokenT::LEFT_PAREN)) expr = callExpr(expr);
+        else if (match(TokenT::LEFT_SQR)) expr = indexExpr(expr);
         else break;
     }
     return expr;
 }
 
 ExprSP Parser::callExpr(ExprSP callee) {
+    auto &paren = previous();
     std::vector<ExprSP> args;
     if (!check(TokenT::RIGHT_PAREN)) {
         do {
@@ -389,17 +444,35 @@ ExprSP Parser::callExpr(ExprSP callee) {
         } while (match(TokenT::COMMA));
     }
     consume(TokenT::RIGHT_PAREN, "Expected ')'.");
-    auto expr = std::make_shared<CallExpr>(callee, args);
+    auto expr = located(make<CallExpr>(callee, args), paren);
     if (!instanceof<FunctionReferenceType>(callee->type)) {
         throw error(peek(), "Unable to deduce return type of indirect call.");
     }
+    auto &argTypes = downcast<FunctionReferenceType>(callee->type)->argTypes;
+    for (size_t i = 0; i < args.size() && i < argTypes.size(); i++) fitArrayLiteral(args[i], argTypes[i]);
     expr->type = downcast<FunctionReferenceType>(callee->type)->returnType;
     return expr;
 }
 
+ExprSP Parser::indexExpr(ExprSP target) {
+    auto &bracket = previous();
+    auto index = expression();
+    consume(TokenT::RIGHT_SQR, "Expected ']' after index.");
+    if (!instanceof<IndexedPointerType>(target->type)) {
+        throw error(bracket, "Only indexed pointers (T[]) can be subscripted.");
+    }
+    static const std::unordered_set<std::string> integers = {"i8", "i16", "i32", "i64", "u8", "u16", "u32", "u64"};
+    if (!instanceof<NamedType>(index->type) || !integers.contains(index->type->toString())) {
+        throw error(bracket, "Index must be an integer.");
+    }
+    auto expr = located(make<IndexExpr>(target, index), bracket);
+    expr->type = downcast<IndexedPointerType>(target->type)->dataType;
+    return expr;
+}
+
 ExprSP Parser::primaryExpr() {
     if (match({TokenT::BOOL_LIT, TokenT::INT_LIT, TokenT::DOUBLE_LIT, TokenT::STRING_LIT})) {
-        auto expr = std::make_shared<LiteralExpr>(previous());
+        auto expr = located(make<LiteralExpr>(previous()), previous());
         TypeSP etype;
         switch(previous().type) {
             case TokenT::BOOL_LIT:
@@ -412,7 +485,7 @@ ExprSP Parser::primaryExpr() {
                 etype = nTypes.at("f64");
                 break;
             case TokenT::STRING_LIT:
-                etype = std::make_shared<IndexedPointerType>(nTypes.at("u8"));
+                etype = make<IndexedPointerType>(nTypes.at("u8"));
                 break;
             default:
                 break;
@@ -422,18 +495,37 @@ ExprSP Parser::primaryExpr() {
     }
 
     if (match(TokenT::IDENTIFIER)) {
-        auto expr = std::make_shared<IdentifierExpr>(previous());
+        auto expr = located(make<IdentifierExpr>(previous()), previous());
         expr->type = getTypeFromID(previous().identName);
         return expr;
     }
 
     if (match(TokenT::LEFT_PAREN)) {
+        auto &paren = previous();
         auto expr = expression();
         consume(TokenT::RIGHT_PAREN, "Expected ')'.");
-        auto out = std::make_shared<GroupExpr>(expr);
+        auto out = located(make<GroupExpr>(expr), paren);
         out->type = expr->type;
         return out;
     }
+
+    if (match(TokenT::LEFT_SQR)) {
+        auto &bracket = previous();
+        std::vector<ExprSP> elements;
+        while (!check(TokenT::RIGHT_SQR)) {
+            elements.push_back(expression());
+            if (!match(TokenT::COMMA)) break;
+        }
+        consume(TokenT::RIGHT_SQR, "Expected ']' after array elements.");
+        if (elements.empty()) throw error(bracket, "Empty array literal.");
+        auto out = located(make<ArrayLiteralExpr>(elements), bracket);
+        out->type = make<IndexedPointerType>(elements.front()->type);
+        if (check(TokenT::IDENTIFIER) && peek().identName == "mutable") {
+            advance();
+            out->writable = true;
+        }
+        return out;
+    }
     throw error(peek(), "Expected expression.");
 }
 
@@ -459,7 +551,7 @@ TypeSP Parser::parseType() {
         consume(TokenT::ARROW, "Expected '->'.");
         auto rtype = parseType();
         consume(TokenT::RIGHT_PAREN, "Expected ')' after argument type list.");
-        TypeSP ref = std::make_shared<FunctionReferenceType>(rtype, argTypes);
+        TypeSP ref = make<FunctionReferenceType>(rtype, argTypes);
         return parsePointerType(ref);
     }
     else if (match(TokenT::LEFT_PAREN)) {
@@ -484,10 +576,10 @@ TypeSP Parser::parsePointerType(const TypeSP &type) {
     do {
         while (match(TokenT::LEFT_SQR)) {
             consume(TokenT::RIGHT_SQR, "Expected ']'.");
-            out = std::make_shared<IndexedPointerType>(out);
+            out = make<IndexedPointerType>(out);
         }
         while (match(TokenT::STAR)) {
-            out = std::make_shared<ReferencePointerType>(out);
+            out = make<ReferencePointerType>(out);
         }
 
     } while (check(TokenT::LEFT_SQR) || check(TokenT::STAR));
@@ -3,6 +3,7 @@
 #include <utility>
 #include <vector>
 
+#include "allocator.hpp"
 #include "token.hpp"
 #include "statement.hpp"
 #include <unordered_map>
@@ -13,14 +14,26 @@
 namespace clpl {
 struct ParseError : public std::exception {
         std::string msg;
-        explicit ParseError(std::string msg) : msg(std::move(msg)) { }
+        int line;
+        std::string detail;
+        // msg is formatted for a terminal, detail is the bare message.
+        ParseError(std::string msg, int line, std::string detail) : msg(std::move(msg)), line(line), detail(std::move(detail)) { }
     };
 
     using SList = std::vector<StmtSP>;
 
+    struct ParserStats {
+        size_t tokens = 0;
+        // Token array plus the heap storage of token strings.
+        size_t tokenBytes = 0;
+        // Symbol table sizes.
+        size_t types = 0;
+        size_t functions = 0;
+        size_t globals = 0;
+    };
+
     class Parser {
         private:
-            bool hadErrors = false;
             std::vector<Token> tokens;
 
             SList scopeStack;
@@ -33,15 +46,22 @@ struct ParseError : public std::exception {
             int current = 0;
             std::string source;
 
+            AllocationHook *allocationHook;
+
         public:
-            explicit Parser(const std::string &src);
+            // All throw ParseError on the first unrecoverable error.
+            explicit Parser(const std::string &src, AllocationHook *allocationHook = nullptr);
             SList parse();
+            // Returns the next top-level statement, or nullptr once the input is exhausted.
+            StmtSP parseNext();
+            ParserStats stats() const;
 
         private:
             StmtSP topLevelStatement();
             StmtSP declaration();
             StmtSP functionDecl();
             StmtSP variableDecl();
+            void fitArrayLiteral(const ExprSP &value, const TypeSP &target);
 
             StmtSP statement();
             StmtSP forStatement();
@@ -65,6 +85,7 @@ struct ParseError : public std::exception {
             ExprSP unary();
             ExprSP memberOpExpr();
             ExprSP callExpr(ExprSP callee);
+            ExprSP indexExpr(ExprSP target);
             ExprSP primaryExpr();
 
 
@@ -88,12 +109,33 @@ struct ParseError : public std::exception {
             template<class T>
             bool isInsideScopeOf();
 
+            // Allocates a node, through the allocation hook when there is one.
+            template<class T, class... Args>
+            std::shared_ptr<T> make(Args&&... args);
+
+            // Attributes node to the position of tok.
+            template<class T>
+            static std::shared_ptr<T> located(std::shared_ptr<T> node, const Token &tok);
+
             bool exists(const std::string &name);
             TypeSP getTypeFromID(const std::string &name);
     };
 
     std::string generateDeclarations(const SList &l);
 
+    template <class T, class... Args>
+    std::shared_ptr<T> Parser::make(Args&&... args) {
+        if (allocationHook == nullptr) return std::make_shared<T>(std::forward<Args>(args)...);
+        return std::allocate_shared<T>(CountingAllocator<T>(allocationHook, typeid(T)), std::forward<Args>(args)...);
+    }
+
+    template <class T>
+    std::shared_ptr<T> Parser::located(std::shared_ptr<T> node, const Token &tok) {
+        node->line = tok.line;
+        node->column = tok.column;
+        return node;
+    }
+
     template <class T>
     bool Parser::isInsideScopeOf() {
         for (const auto &i : scopeStack) {
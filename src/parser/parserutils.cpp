@@ -20,7 +20,7 @@ ParseError Parser::error(const Token &tok, const std::string &msg) {
     auto message = "(at token " + tok.toString() + ")\033[0m\n";
     message = "\033[1;31mError: (at line " + std::to_string(tok.line) + ") " + message;
     message += "\t\033[1m" + msg + "\033[0m"; 
-    return ParseError(message);
+    return ParseError(message, tok.line, msg + " (at token " + tok.toString() + ")");
 }
 
 bool Parser::check(const TokenT tokt) {
@@ -84,6 +84,8 @@ TypeSP Parser::getTypeFromID(const std::string &name) {
 }
 
 std::string clpl::generateDeclarations(const SList &l) {
+    // Globals are internal to the file that defines them. A declaration here would compile as a
+    // separate zero-initialized copy in every file that includes it, so they are left out.
     std::string out {"// GENERATED FILE\n"};
     for (const auto &st : l) {
         if (instanceof<FuncDeclStmt>(st)) {
@@ -96,11 +98,6 @@ std::string clpl::generateDeclarations(const SList &l) {
             }
             out += ")->" + fn->type->toString() + ";\n";
         }
-
-        if (instanceof<VarDeclStmt>(st)) {
-            auto vdc = downcast<VarDeclStmt>(st);
-            out += "var " + vdc->name.identName + ":" + vdc->type->toString() + ";\n";
-        }
     }
     return out;
 }
\ No newline at end of file
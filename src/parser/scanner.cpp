@@ -32,9 +32,10 @@ Scanner::Scanner(const std::string &src) {
 std::vector<Token> Scanner::tokenize() {
     while (!atEnd()) {
         start = current;
+        column = start - lineStart + 1;
         scanToken();
     }
-    tokens.emplace_back(line);
+    tokens.emplace_back(line, current - lineStart + 1);
     return tokens;
 }
 
@@ -112,6 +113,7 @@ void Scanner::scanToken() {
             break;
         case '\n':
             line++;
+            lineStart = current;
             break;
         case '"':
             scanString();
@@ -120,7 +122,7 @@ void Scanner::scanToken() {
         default:
             if (isDigit(c)) scanNumber();
             else if (isAlpha(c)) scanIdentifier();
-            else throw c;
+            else throw ScanError(std::string("Unexpected character '") + c + "'.", line);
             break;
     }
 }
@@ -164,7 +166,7 @@ bool Scanner::atEnd() {
 }
 
 void Scanner::addToken(const TokenT &tokt) {
-    Token tok(line);
+    Token tok(line, column);
     tok.type = tokt;
     tokens.push_back(tok);
 }
@@ -179,14 +181,14 @@ void Scanner::scanIdentifier() {
     std::string text = src.substr(start, current - start);
 
     if (keywords.count(text) == 0) {
-        Token tok(line);
+        Token tok(line, column);
         tok.type = TokenT::IDENTIFIER;
         tok.identName = text;
         addToken(tok);
         return;
     }
     else {
-        Token tok(line);
+        Token tok(line, column);
         tok.type = keywords[text];
         if (tok.type == TokenT::BOOL_LIT) {
             tok.boolValue = text == "true";
@@ -203,14 +205,14 @@ void Scanner::scanNumber() {
         advance();
         while (isDigit(peek())) advance();
 
-        Token tok(line);
+        Token tok(line, column);
         tok.type = TokenT::DOUBLE_LIT;
         tok.doubleValue = std::stod(src.substr(start, current - start));
         addToken(tok);
         return;
     }
 
-    Token tok(line);
+    Token tok(line, column);
     tok.type = TokenT::INT_LIT;
     tok.intValue = std::stoi(src.substr(start, current - start));
     addToken(tok);
@@ -218,12 +220,15 @@ void Scanner::scanNumber() {
 
 void Scanner::scanString() {
     while (peek() != '"' && !atEnd()) {
-        if (peek() == '\n') line++;
+        if (peek() == '\n') {
+            line++;
+            lineStart = current + 1;
+        }
         advance();
     }
 
     if (atEnd()) {
-        throw 2;
+        throw ScanError("Unterminated string literal.", line);
     }
 
     advance();
@@ -231,7 +236,7 @@ void Scanner::scanString() {
     auto val = src.substr(start + 1, current - start - 2);
     val = formatEscapes(val);
 
-    Token tok(line);
+    Token tok(line, column);
     tok.type = TokenT::STRING_LIT;
     tok.strValue = val;
     addToken(tok);
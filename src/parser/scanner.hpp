@@ -2,16 +2,25 @@
 
 #include "token.hpp"
 
+#include <utility>
 #include <vector>
 #include <unordered_map>
 
 namespace clpl {
+    struct ScanError : public std::exception {
+        std::string msg;
+        int line;
+        ScanError(std::string msg, int line) : msg(std::move(msg)), line(line) { }
+    };
+
     class Scanner {
         private:
             std::vector<Token> tokens;
             std::unordered_map<std::string, TokenT> keywords;
 
             int start = 0, current = 0, line = 1;
+            // Offset of the current line, and the column the token being scanned starts at.
+            int lineStart = 0, column = 1;
             std::string src;
 
         public:
@@ -6,6 +6,8 @@
 
 namespace clpl {
     struct Stmt {
+        // Where the statement starts; 0 when it was not parsed from source.
+        int line = 0, column = 0;
         virtual ~Stmt() = default;
     };
 
@@ -30,6 +32,12 @@ namespace clpl {
     struct ParameterT {
         TypeSP type;
         Token name;
+        // Qualifiers of pointer parameters, written after the type (`dst: f32[] restrict`):
+        // restrict promises no other pointer the function uses reaches the same memory, nocapture
+        // that no copy of the pointer outlives the call, readonly that nothing is written through it.
+        bool restrict = false;
+        bool nocapture = false;
+        bool readonly = false;
     };
 
     struct FuncDeclStmt : public Stmt {
@@ -12,10 +12,12 @@ Token::Token() {
     doubleValue = 0.0;
     boolValue = false;
     line = 0;
+    column = 0;
 }
 
-Token::Token(int line) : Token() {
+Token::Token(int line, int column) : Token() {
     this->line = line;
+    this->column = column;
 }
 
 Token::Token(const Token &other) {
@@ -26,6 +28,7 @@ Token::Token(const Token &other) {
     doubleValue = other.doubleValue;
     boolValue = other.boolValue;
     line = other.line;
+    column = other.column;
 }
 
 std::string Token::toString() const {
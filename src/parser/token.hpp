@@ -69,10 +69,12 @@ namespace clpl {
         double doubleValue;
         bool boolValue;
 
+        // 1-based; column counts bytes from the start of the line.
         int line;
+        int column;
 
         Token();
-        explicit Token(int line);
+        explicit Token(int line, int column = 0);
         Token(const Token &other);
 
         std::string toString() const;
@@ -0,0 +1,139 @@
+#include "clplrt.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern struct clplrt_counter __start_clpl_counters[] __attribute__((weak));
+extern struct clplrt_counter __stop_clpl_counters[] __attribute__((weak));
+
+// Instrumented modules reference this so that linking with the static library pulls this file in.
+int clplrt_counters_runtime;
+
+// Filled in at startup, since a dump may happen in a signal handler where malloc and getenv are off limits.
+static struct clplrt_counter **sorted;
+static size_t count;
+static const char *output_path;
+
+static uint64_t weight(const struct clplrt_counter *c) {
+    return c->cycles != 0 ? c->cycles : c->calls;
+}
+
+// Heapsort by descending weight; qsort may allocate.
+static void sift(struct clplrt_counter **a, size_t root, size_t n) {
+    while (2 * root + 1 < n) {
+        size_t child = 2 * root + 1;
+        if (child + 1 < n && weight(a[child + 1]) < weight(a[child])) child++;
+        if (weight(a[root]) <= weight(a[child])) return;
+        struct clplrt_counter *tmp = a[root];
+        a[root] = a[child];
+        a[child] = tmp;
+        root = child;
+    }
+}
+
+static void sort_counters(void) {
+    for (size_t i = count / 2; i-- > 0;) sift(sorted, i, count);
+    for (size_t end = count; end-- > 1;) {
+        struct clplrt_counter *tmp = sorted[0];
+        sorted[0] = sorted[end];
+        sorted[end] = tmp;
+        sift(sorted, 0, end);
+    }
+}
+
+struct buffer {
+    char data[4096];
+    size_t len;
+    int fd;
+};
+
+static void flush(struct buffer *b) {
+    size_t done = 0;
+    while (done < b->len) {
+        ssize_t n = write(b->fd, b->data + done, b->len - done);
+        if (n <= 0) break;
+        done += n;
+    }
+    b->len = 0;
+}
+
+static void put(struct buffer *b, const char *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (b->len == sizeof(b->data)) flush(b);
+        b->data[b->len++] = s[i];
+    }
+}
+
+static void put_string(struct buffer *b, const char *s) {
+    put(b, s, strlen(s));
+}
+
+// Right-aligned in width columns.
+static void put_number(struct buffer *b, uint64_t v, int width) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v != 0);
+    for (int i = n; i < width; i++) put(b, " ", 1);
+    while (n > 0) put(b, &digits[--n], 1);
+}
+
+void clplrt_dump_counters(void) {
+    if (sorted == NULL || count == 0) return;
+
+    int saved = errno;
+    struct buffer b = {.len = 0, .fd = 2};
+    int fd = output_path != NULL ? open(output_path, O_WRONLY | O_CREAT | O_APPEND, 0644) : -1;
+    if (fd >= 0) b.fd = fd;
+
+    sort_counters();
+    put_string(&b, "clplrt: per-function counters of pid ");
+    put_number(&b, (uint64_t) getpid(), 0);
+    put_string(&b, "\n               calls               cycles     cycles/call  function\n");
+    for (size_t i = 0; i < count; i++) {
+        const struct clplrt_counter *c = sorted[i];
+        if (c->calls == 0) continue;
+        put_number(&b, c->calls, 20);
+        put_number(&b, c->cycles, 21);
+        put_number(&b, c->cycles / c->calls, 16);
+        put_string(&b, "  ");
+        put_string(&b, c->name);
+        put_string(&b, "\n");
+    }
+    flush(&b);
+
+    if (fd >= 0) close(fd);
+    errno = saved;
+}
+
+static void on_signal(int sig) {
+    clplrt_dump_counters();
+}
+
+__attribute__((constructor))
+static void init_counters(void) {
+    if (__start_clpl_counters == NULL || __stop_clpl_counters == NULL) return;
+    count = __stop_clpl_counters - __start_clpl_counters;
+    sorted = malloc(count * sizeof(*sorted));
+    if (sorted == NULL) return;
+    for (size_t i = 0; i < count; i++) sorted[i] = &__start_clpl_counters[i];
+    output_path = getenv("CLPL_COUNTERS_FILE");
+
+    atexit(clplrt_dump_counters);
+
+    struct sigaction old;
+    if (sigaction(SIGUSR1, NULL, &old) == 0 && old.sa_handler == SIG_DFL) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_signal;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGUSR1, &sa, NULL);
+    }
+}
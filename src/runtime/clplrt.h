@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+// Runtime for programs compiled with clplc -finstrument. Link the program with -lclplrt.
+//
+// Every instrumented function owns one record in the clpl_counters section; the linker brackets
+// that section with __start_/__stop_ symbols, so no registration code runs. The table is printed
+// to stderr (or to $CLPL_COUNTERS_FILE) at exit and whenever the process receives SIGUSR1,
+// unless the program installed its own SIGUSR1 handler first.
+//
+// Counters are updated without atomics, like LLVM's profile counters: concurrent calls of one
+// function may lose counts. Cycles are inclusive of callees, so recursion counts them twice.
+
+struct clplrt_counter {
+    uint64_t calls;
+    // Sum of llvm.readcyclecounter deltas between entry and return; 0 without -finstrument=cycles.
+    uint64_t cycles;
+    const char *name;
+};
+
+// Prints the table now; async-signal-safe.
+void clplrt_dump_counters(void);